@@ -0,0 +1,79 @@
+// 统计每个任务从提交到取回结果所需的堆分配次数
+// 旧方式：make_shared<packaged_task> + std::bind + std::function + std::queue
+// 新方式：线程池的 Submit（InlineTask + 内存池分配的 promise 共享状态）
+//
+// 默认测试 simple_threadpool，定义 BENCH_RESIZE_POOL 时测试 threadpool_resize，
+// 分别对应 bench/CMakeLists.txt 中的 alloc_bench_simple 和 alloc_bench_resize
+#ifdef BENCH_RESIZE_POOL
+#include "thread_pool.h"
+#else
+#include "threadPool.h"
+#endif
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <queue>
+
+static std::atomic<long long> g_allocations(0);
+
+void *operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+int add(int a, int b) { return a + b; }
+
+// 重现改造前 Submit 的做法，在单线程里完成入队、执行和取结果
+double LegacyAllocsPerTask(int n) {
+    std::queue<std::function<void()>> tasks;
+    long long sum = 0;
+    long long before = g_allocations.load();
+    for (int i = 0; i < n; ++i) {
+        auto task_ptr = std::make_shared<std::packaged_task<int()>>(
+            std::bind(add, i, 1));
+        std::future<int> fut = task_ptr->get_future();
+        tasks.emplace([task_ptr]() { (*task_ptr)(); });
+        tasks.front()();
+        tasks.pop();
+        sum += fut.get();
+    }
+    long long after = g_allocations.load();
+    std::printf("  (checksum %lld)\n", sum);
+    return static_cast<double>(after - before) / n;
+}
+
+double PoolAllocsPerTask(ThreadPool &pool, int n) {
+    long long sum = 0;
+    long long before = g_allocations.load();
+    for (int i = 0; i < n; ++i) {
+        sum += pool.Submit(add, i, 1).get();
+    }
+    long long after = g_allocations.load();
+    std::printf("  (checksum %lld)\n", sum);
+    return static_cast<double>(after - before) / n;
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    double legacy = LegacyAllocsPerTask(n);
+
+    ThreadPool pool(2);
+    // 预热：让内存池和任务队列达到稳定容量
+    PoolAllocsPerTask(pool, 1000);
+    double pooled = PoolAllocsPerTask(pool, n);
+
+    std::printf("tasks=%d\n", n);
+    std::printf("before (packaged_task+bind+std::function): %.3f allocs/task\n",
+                legacy);
+    std::printf("after  (InlineTask+pooled promise):        %.3f allocs/task\n",
+                pooled);
+    return 0;
+}
@@ -0,0 +1,89 @@
+// 统计 cache_threadpool_handle 每个任务从提交到取回结果所需的堆分配次数
+// 旧方式：make_shared 创建任务，返回值封装在 Any 中
+// 新方式：makeTask 从内存池创建任务，引用计数保存在任务内部
+#include "threadpool.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<long long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+class AddTask :public Task
+{
+public:
+    AddTask(int a, int b) :_a(a), _b(b) {}
+    Any run() override
+    {
+        return _a + _b;
+    }
+private:
+    int _a;
+    int _b;
+};
+
+class TypedAddTask :public TypedTask<int>
+{
+public:
+    TypedAddTask(int a, int b) :_a(a), _b(b) {}
+    int call() override
+    {
+        return _a + _b;
+    }
+private:
+    int _a;
+    int _b;
+};
+
+template<typename Submit>
+double AllocsPerTask(int n, Submit submit)
+{
+    long long sum = 0;
+    long long before = g_allocations.load();
+    for (int i = 0; i < n; i++)
+        sum += submit(i);
+    long long after = g_allocations.load();
+    std::printf("  (checksum %lld)\n", sum);
+    return static_cast<double>(after - before) / n;
+}
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    ThreadPool pool(2);
+    pool.start();
+    auto shared = [&](int i) {
+        return pool.submit(std::make_shared<AddTask>(i, 1)).get().cast<int>();
+    };
+    auto pooled = [&](int i) {
+        return pool.submit(makeTask<AddTask>(i, 1)).get().cast<int>();
+    };
+    auto typed = [&](int i) {
+        return pool.submit(makeTask<TypedAddTask>(i, 1)).get();
+    };
+    // 预热：让内存池达到稳定容量
+    AllocsPerTask(1000, shared);
+    AllocsPerTask(1000, pooled);
+    AllocsPerTask(1000, typed);
+
+    double sharedAllocs = AllocsPerTask(n, shared);
+    double pooledAllocs = AllocsPerTask(n, pooled);
+    double typedAllocs = AllocsPerTask(n, typed);
+    std::printf("tasks=%d\n", n);
+    std::printf("make_shared<Task> + Any:   %.3f allocs/task\n", sharedAllocs);
+    std::printf("makeTask<Task> + Any:      %.3f allocs/task\n", pooledAllocs);
+    std::printf("makeTask<TypedTask<int>>:  %.3f allocs/task\n", typedAllocs);
+    return 0;
+}
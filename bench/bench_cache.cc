@@ -0,0 +1,54 @@
+// cache_threadpool_handle 的基准测试
+#include "threadpool.h"
+#include "workloads.h"
+
+//把lambda包装成TypedTask提交
+template<typename F>
+class LambdaTask :public TypedTask<void>
+{
+public:
+    explicit LambdaTask(F f) :_f(std::move(f)) {}
+    void call() override
+    {
+        _f();
+    }
+private:
+    F _f;
+};
+
+class CachePool
+{
+public:
+    explicit CachePool(int threads) :_pool(threads)
+    {
+        //吞吐测试会一次性提交大量任务，避免队列满导致提交失败；容量是所有优先级的总和
+        _pool.setTaskQueueMaxSize(PRIORITY_LEVELS << 18);
+        _pool.start();
+    }
+
+    static const char* Name() { return "cache"; }
+
+    template<typename F>
+    TypedResult<void> Submit(F f)
+    {
+        return _pool.submit(makeTask<LambdaTask<F>>(std::move(f)));
+    }
+
+    template<typename F>
+    void Post(F f)
+    {
+        _pool.submit(makeTask<LambdaTask<F>>(std::move(f)));
+    }
+
+private:
+    ThreadPool _pool;
+};
+
+int main(int argc, char** argv)
+{
+    bench::Options opt = bench::ParseOptions(argc, argv);
+    std::vector<bench::Record> records;
+    bench::RunSuite<CachePool>(opt, records);
+    bench::WriteRecords(opt, records);
+    return 0;
+}
@@ -0,0 +1,53 @@
+// threadpool_resize 的基准测试，对比单队列的 ThreadPool 和分片队列的 ShardedThreadPool
+#include "sharded_thread_pool.h"
+#include "thread_pool.h"
+#include "workloads.h"
+
+class ResizePool {
+public:
+    explicit ResizePool(int threads) : pool_(threads) {}
+
+    static const char* Name() { return "resize"; }
+
+    template<typename F>
+    std::future<void> Submit(F f) {
+        return pool_.Submit(std::move(f));
+    }
+
+    template<typename F>
+    void Post(F f) {
+        pool_.Post(std::move(f));
+    }
+
+private:
+    ThreadPool pool_;
+};
+
+class ShardedPool {
+public:
+    explicit ShardedPool(int threads) : pool_(threads) {}
+
+    static const char* Name() { return "resize_sharded"; }
+
+    template<typename F>
+    std::future<void> Submit(F f) {
+        return pool_.Submit(std::move(f));
+    }
+
+    template<typename F>
+    void Post(F f) {
+        pool_.Post(std::move(f));
+    }
+
+private:
+    ShardedThreadPool pool_;
+};
+
+int main(int argc, char** argv) {
+    bench::Options opt = bench::ParseOptions(argc, argv);
+    std::vector<bench::Record> records;
+    bench::RunSuite<ResizePool>(opt, records);
+    bench::RunSuite<ShardedPool>(opt, records);
+    bench::WriteRecords(opt, records);
+    return 0;
+}
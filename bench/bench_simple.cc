@@ -0,0 +1,36 @@
+// simple_threadpool 的基准测试，分别测试共享队列和工作窃取两种调度模式
+#include "threadPool.h"
+#include "workloads.h"
+
+template <ScheduleMode Mode>
+class SimplePool {
+ public:
+    explicit SimplePool(int threads) : pool_(threads, Mode) {}
+
+    static const char *Name() {
+        return Mode == ScheduleMode::kWorkStealing ? "simple_stealing"
+                                                   : "simple";
+    }
+
+    template <typename F>
+    std::future<void> Submit(F f) {
+        return pool_.Submit(std::move(f));
+    }
+
+    template <typename F>
+    void Post(F f) {
+        pool_.Submit(std::move(f));
+    }
+
+ private:
+    ThreadPool pool_;
+};
+
+int main(int argc, char **argv) {
+    bench::Options opt = bench::ParseOptions(argc, argv);
+    std::vector<bench::Record> records;
+    bench::RunSuite<SimplePool<ScheduleMode::kGlobalQueue>>(opt, records);
+    bench::RunSuite<SimplePool<ScheduleMode::kWorkStealing>>(opt, records);
+    bench::WriteRecords(opt, records);
+    return 0;
+}
@@ -0,0 +1,347 @@
+#ifndef BENCH_WORKLOADS_H
+#define BENCH_WORKLOADS_H
+
+// 三种线程池共用的基准测试负载
+// 每个 bench_xxx.cc 提供一个适配器 Pool，要求：
+//   Pool(int threads);
+//   static const char *Name();
+//   template <typename F> Handle Submit(F f);   // Handle 提供 void get()
+//   template <typename F> void Post(F f);       // 不关心结果的提交
+// 然后对每个适配器调用 RunSuite<Pool>，最后用 WriteRecords 输出 CSV/JSON
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::vector<int> threads;
+    long tasks = 200000;       // 吞吐测试的任务数
+    long samples = 20000;      // 延迟测试的采样数
+    int fanout = 256;          // 每轮扇出的任务数
+    int rounds = 200;          // 扇出/扇入的轮数
+    int depth = 14;            // 递归派生的深度（共 2^depth - 1 个任务）
+    int mixed = 2000;          // 混合负载的任务数
+    std::string format = "csv";
+    std::string out;
+    std::string only;          // 只运行指定名称的负载
+};
+
+struct Record {
+    std::string pool;
+    std::string workload;
+    int threads;
+    std::string metric;
+    double value;
+    std::string unit;
+};
+
+inline double Seconds(Clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+inline long long Nanos(Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+// 占用 CPU 大约 ns 纳秒，避免编译器优化掉
+inline void Spin(long long ns) {
+    auto end = Clock::now() + std::chrono::nanoseconds(ns);
+    volatile unsigned sink = 0;
+    while (Clock::now() < end) {
+        for (int i = 0; i < 64; ++i)
+            sink = sink + i;
+    }
+}
+
+// 空任务吞吐：一次性提交大量空任务，等待全部完成
+template <typename Pool>
+void EmptyTaskThroughput(Pool &pool, const Options &opt, int threads,
+                         std::vector<Record> &out) {
+    std::atomic<long> done(0);
+    auto start = Clock::now();
+    for (long i = 0; i < opt.tasks; ++i) {
+        pool.Post([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+    }
+    while (done.load(std::memory_order_acquire) < opt.tasks)
+        std::this_thread::yield();
+    double secs = Seconds(Clock::now() - start);
+    out.push_back({Pool::Name(), "empty_throughput", threads, "tasks_per_sec",
+                   opt.tasks / secs, "1/s"});
+    out.push_back({Pool::Name(), "empty_throughput", threads, "ns_per_task",
+                   secs * 1e9 / opt.tasks, "ns"});
+}
+
+// 多提交者吞吐：与线程数相同个数的提交者线程同时提交空任务，衡量提交路径上的锁争用
+template <typename Pool>
+void MultiProducerThroughput(Pool &pool, const Options &opt, int threads,
+                             std::vector<Record> &out) {
+    int producers = std::max(threads, 2);
+    long per_producer = opt.tasks / producers;
+    long total = per_producer * producers;
+    std::atomic<long> done(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (int p = 0; p < producers; ++p) {
+        workers.emplace_back([&]() {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (long i = 0; i < per_producer; ++i) {
+                pool.Post([&done]() {
+                    done.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &t : workers)
+        t.join();
+    double submit_secs = Seconds(Clock::now() - start);
+    while (done.load(std::memory_order_acquire) < total)
+        std::this_thread::yield();
+    double secs = Seconds(Clock::now() - start);
+    out.push_back({Pool::Name(), "multi_producer", threads, "submits_per_sec",
+                   total / submit_secs, "1/s"});
+    out.push_back({Pool::Name(), "multi_producer", threads, "tasks_per_sec",
+                   total / secs, "1/s"});
+}
+
+// 提交到开始执行的延迟：线程池空闲时逐个提交，记录每个任务的等待时间
+template <typename Pool>
+void SubmitLatency(Pool &pool, const Options &opt, int threads,
+                   std::vector<Record> &out) {
+    std::vector<long long> lat(opt.samples);
+    for (long i = 0; i < opt.samples; ++i) {
+        auto submitted = Clock::now();
+        auto handle = pool.Submit([&lat, i, submitted]() {
+            lat[i] = Nanos(Clock::now() - submitted);
+        });
+        handle.get();
+    }
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&lat](double p) {
+        size_t idx = static_cast<size_t>(p * (lat.size() - 1));
+        return static_cast<double>(lat[idx]);
+    };
+    const char *names[] = {"p50", "p90", "p99", "p999"};
+    const double ps[] = {0.5, 0.9, 0.99, 0.999};
+    for (int i = 0; i < 4; ++i) {
+        out.push_back({Pool::Name(), "submit_latency", threads, names[i],
+                       pct(ps[i]), "ns"});
+    }
+    out.push_back({Pool::Name(), "submit_latency", threads, "max",
+                   static_cast<double>(lat.back()), "ns"});
+}
+
+// 扇出/扇入：每轮提交 fanout 个小任务，全部完成后进入下一轮
+template <typename Pool>
+void FanOutFanIn(Pool &pool, const Options &opt, int threads,
+                 std::vector<Record> &out) {
+    auto start = Clock::now();
+    for (int r = 0; r < opt.rounds; ++r) {
+        auto work = []() { Spin(1000); };
+        std::vector<decltype(pool.Submit(work))> handles;
+        handles.reserve(opt.fanout);
+        for (int i = 0; i < opt.fanout; ++i) {
+            handles.push_back(pool.Submit(work));
+        }
+        for (auto &h : handles)
+            h.get();
+    }
+    double secs = Seconds(Clock::now() - start);
+    out.push_back({Pool::Name(), "fanout_fanin", threads, "rounds_per_sec",
+                   opt.rounds / secs, "1/s"});
+    out.push_back({Pool::Name(), "fanout_fanin", threads, "us_per_round",
+                   secs * 1e6 / opt.rounds, "us"});
+}
+
+// 递归派生：任务在工作线程内部继续提交两个子任务，形成满二叉树
+template <typename Pool>
+struct Spawner {
+    Pool *pool;
+    std::atomic<long> *done;
+    int depth;
+    void operator()() const {
+        if (depth > 1) {
+            pool->Post(Spawner{pool, done, depth - 1});
+            pool->Post(Spawner{pool, done, depth - 1});
+        }
+        done->fetch_add(1, std::memory_order_release);
+    }
+};
+
+template <typename Pool>
+void RecursiveSpawn(Pool &pool, const Options &opt, int threads,
+                    std::vector<Record> &out) {
+    long total = (1L << opt.depth) - 1;
+    std::atomic<long> done(0);
+    auto start = Clock::now();
+    pool.Post(Spawner<Pool>{&pool, &done, opt.depth});
+    while (done.load(std::memory_order_acquire) < total)
+        std::this_thread::yield();
+    double secs = Seconds(Clock::now() - start);
+    out.push_back({Pool::Name(), "recursive_spawn", threads, "tasks_per_sec",
+                   total / secs, "1/s"});
+}
+
+// 混合负载：一半任务纯计算，一半任务阻塞（模拟 IO）
+template <typename Pool>
+void MixedCpuBlocking(Pool &pool, const Options &opt, int threads,
+                      std::vector<Record> &out) {
+    std::atomic<long> done(0);
+    auto start = Clock::now();
+    for (int i = 0; i < opt.mixed; ++i) {
+        if (i % 2 == 0) {
+            pool.Post([&done]() {
+                Spin(20000);
+                done.fetch_add(1, std::memory_order_release);
+            });
+        } else {
+            pool.Post([&done]() {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                done.fetch_add(1, std::memory_order_release);
+            });
+        }
+    }
+    while (done.load(std::memory_order_acquire) < opt.mixed)
+        std::this_thread::yield();
+    double secs = Seconds(Clock::now() - start);
+    out.push_back({Pool::Name(), "mixed_cpu_blocking", threads, "wall_time",
+                   secs * 1e3, "ms"});
+}
+
+inline std::vector<int> ParseList(const char *s) {
+    std::vector<int> values;
+    while (*s) {
+        values.push_back(std::atoi(s));
+        const char *comma = std::strchr(s, ',');
+        if (!comma)
+            break;
+        s = comma + 1;
+    }
+    return values;
+}
+
+inline Options ParseOptions(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        auto value = [arg](const char *name) -> const char * {
+            size_t len = std::strlen(name);
+            if (std::strncmp(arg, name, len) == 0 && arg[len] == '=')
+                return arg + len + 1;
+            return nullptr;
+        };
+        if (const char *v = value("--threads"))
+            opt.threads = ParseList(v);
+        else if (const char *v = value("--tasks"))
+            opt.tasks = std::atol(v);
+        else if (const char *v = value("--samples"))
+            opt.samples = std::atol(v);
+        else if (const char *v = value("--fanout"))
+            opt.fanout = std::atoi(v);
+        else if (const char *v = value("--rounds"))
+            opt.rounds = std::atoi(v);
+        else if (const char *v = value("--depth"))
+            opt.depth = std::atoi(v);
+        else if (const char *v = value("--mixed"))
+            opt.mixed = std::atoi(v);
+        else if (const char *v = value("--format"))
+            opt.format = v;
+        else if (const char *v = value("--out"))
+            opt.out = v;
+        else if (const char *v = value("--only"))
+            opt.only = v;
+        else {
+            std::fprintf(stderr,
+                         "usage: %s [--threads=1,2,4] [--tasks=N] "
+                         "[--samples=N] [--fanout=N] [--rounds=N] "
+                         "[--depth=N] [--mixed=N] [--format=csv|json] "
+                         "[--out=file] [--only=workload]\n",
+                         argv[0]);
+            std::exit(2);
+        }
+    }
+    if (opt.threads.empty()) {
+        int hw = static_cast<int>(std::thread::hardware_concurrency());
+        opt.threads = {1, 2};
+        if (hw > 2)
+            opt.threads.push_back(hw);
+    }
+    return opt;
+}
+
+inline void WriteRecords(const Options &opt, const std::vector<Record> &recs) {
+    FILE *fp = stdout;
+    if (!opt.out.empty()) {
+        fp = std::fopen(opt.out.c_str(), "w");
+        if (!fp) {
+            std::perror(opt.out.c_str());
+            std::exit(1);
+        }
+    }
+    if (opt.format == "json") {
+        std::fprintf(fp, "[\n");
+        for (size_t i = 0; i < recs.size(); ++i) {
+            const Record &r = recs[i];
+            std::fprintf(fp,
+                         "  {\"pool\": \"%s\", \"workload\": \"%s\", "
+                         "\"threads\": %d, \"metric\": \"%s\", "
+                         "\"value\": %.3f, \"unit\": \"%s\"}%s\n",
+                         r.pool.c_str(), r.workload.c_str(), r.threads,
+                         r.metric.c_str(), r.value, r.unit.c_str(),
+                         i + 1 < recs.size() ? "," : "");
+        }
+        std::fprintf(fp, "]\n");
+    } else {
+        std::fprintf(fp, "pool,workload,threads,metric,value,unit\n");
+        for (const Record &r : recs) {
+            std::fprintf(fp, "%s,%s,%d,%s,%.3f,%s\n", r.pool.c_str(),
+                         r.workload.c_str(), r.threads, r.metric.c_str(),
+                         r.value, r.unit.c_str());
+        }
+    }
+    if (fp != stdout)
+        std::fclose(fp);
+}
+
+template <typename Pool>
+void RunSuite(const Options &opt, std::vector<Record> &records) {
+    using Workload = void (*)(Pool &, const Options &, int,
+                              std::vector<Record> &);
+    struct Entry {
+        const char *name;
+        Workload fn;
+    };
+    const Entry entries[] = {
+        {"empty_throughput", &EmptyTaskThroughput<Pool>},
+        {"multi_producer", &MultiProducerThroughput<Pool>},
+        {"submit_latency", &SubmitLatency<Pool>},
+        {"fanout_fanin", &FanOutFanIn<Pool>},
+        {"recursive_spawn", &RecursiveSpawn<Pool>},
+        {"mixed_cpu_blocking", &MixedCpuBlocking<Pool>},
+    };
+    for (int threads : opt.threads) {
+        for (const Entry &e : entries) {
+            if (!opt.only.empty() && opt.only != e.name)
+                continue;
+            // 每个负载使用新的线程池，互不影响
+            Pool pool(threads);
+            e.fn(pool, opt, threads, records);
+        }
+    }
+}
+
+} // namespace bench
+
+#endif // BENCH_WORKLOADS_H
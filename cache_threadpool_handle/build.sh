@@ -1,12 +1,12 @@
-# 编译生成动态库
-g++ -fPIC -shared -I ./include/  ./src/semaphore.cc ./src/threadpool.cc  -std=c++17  -o ./lib/libthreadpool.so
+# 编译生成动态库，THREADPOOL_TRACE与CMake的默认选项一致，编译线程池内部的跟踪点
+g++ -fPIC -shared -I ./include/ -I ../common/ -DTHREADPOOL_TRACE ./src/completion.cc ./src/threadpool.cc ./src/trace.cc ./src/wait_strategy.cc ./src/scaling.cc  -std=c++17  -o ./lib/libthreadpool.so
 # 将动态库移动到系统库目录下
 cp ./lib/libthreadpool.so /usr/local/lib
-# 将头文件放到系统include目录下
-cp ./include/threadpool.h /usr/local/include
+# 将头文件放到系统include目录下，threadpool.h依赖include目录下的其他头文件
+cp ./include/*.h ../common/*.h /usr/local/include
 # 编译生成测试代码
-g++ -I ./include/ ./src/main.cc -std=c++17 -lthreadpool -lpthread -g -o ./example/main
+g++ -I ./include/ -I ../common/ -DTHREADPOOL_TRACE ./src/main.cc -std=c++17 -lthreadpool -lpthread -g -o ./example/main
 # 更新动态链接库配置
 echo '/usr/local/lib' > /etc/ld.so.conf.d/mylib.conf
 # 刷新动态链接库的配置使其生效
-ldconfig
\ No newline at end of file
+ldconfig
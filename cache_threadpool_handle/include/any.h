@@ -1,6 +1,20 @@
 #ifndef ANY_H
 #define ANY_H
 #include<memory>
+#include<typeinfo>
+#include<new>
+#include "object_pool.h"
+
+//Any中保存的类型与cast的目标类型不一致
+class BadAnyCast : public std::bad_cast
+{
+public:
+	const char* what() const noexcept override
+	{
+		return "type is unmatch!";
+	}
+};
+
 class Any
 {
 public:
@@ -11,8 +25,9 @@ public:
 	Any(Any&&) = default;
 	Any& operator=(Any&&) = default;
 
+	//保存的数据从内存池中分配，稳定运行后不再调用malloc
 	template<typename T>
-	Any(T data) : base_(std::make_unique<Derive<T>>(data))
+	Any(T data) : base_(create(data))
 	{}
 
 	template<typename T>
@@ -21,7 +36,7 @@ public:
 		Derive<T>* pd = dynamic_cast<Derive<T>*>(base_.get());
 		if (pd == nullptr)
 		{
-			throw "type is unmatch!";
+			throw BadAnyCast();
 		}
 		return pd->data_;
 	}
@@ -30,6 +45,31 @@ private:
 	{
 	public:
 		virtual ~Base() = default;
+		//析构并把内存归还给对应大小的内存池
+		virtual void destroy() = 0;
+	};
+
+	template<typename T>
+	static Base* create(T& data)
+	{
+		void* mem = ObjectPool<Derive<T>>::allocate();
+		try
+		{
+			return new (mem) Derive<T>(data);
+		}
+		catch (...)
+		{
+			ObjectPool<Derive<T>>::deallocate(mem);
+			throw;
+		}
+	}
+
+	struct Deleter
+	{
+		void operator()(Base* base) const
+		{
+			base->destroy();
+		}
 	};
 
 	template<typename T>
@@ -38,10 +78,15 @@ private:
 	public:
 		Derive(T data) : data_(data)
 		{}
+		void destroy() override
+		{
+			this->~Derive();
+			ObjectPool<Derive>::deallocate(this);
+		}
 		T data_;  //                    
 	};
 
 private:
-	std::unique_ptr<Base> base_;
+	std::unique_ptr<Base, Deleter> base_;
 };
 #endif
\ No newline at end of file
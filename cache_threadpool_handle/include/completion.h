@@ -0,0 +1,46 @@
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <atomic>
+#include "wait_strategy.h"
+
+/*
+一次性的完成标志，只有一个原子整数
+complete在没有等待者时只是一次原子交换，不加锁也不进入内核；
+已经完成时wait和isDone只需要一次原子读
+有等待者时在Linux上通过futex睡眠和唤醒，其他平台退化为按地址分桶的条件变量
+*/
+class Completion {
+public:
+    Completion() = default;
+    Completion(const Completion&) = delete;
+    Completion& operator=(const Completion&) = delete;
+
+    bool isDone()const
+    {
+        return _state.load(std::memory_order_acquire) == DONE;
+    }
+    //标记完成并唤醒所有等待者
+    void complete();
+    //阻塞直到complete被调用
+    void wait();
+    //任务重新提交时恢复为未完成，只有已经完成时才生效
+    void reset();
+
+    //设置等待完成时的自旋策略，影响Result::get等等待任务结果的线程
+    static void setWaitStrategy(const WaitStrategy& strategy);
+    static WaitStrategy getWaitStrategy();
+
+private:
+    static const int PENDING = 0;
+    //未完成并且至少有一个线程已经或即将睡眠，complete需要唤醒
+    static const int WAITING = 1;
+    static const int DONE = 2;
+
+    //所有完成标志共享的自旋状态，等待时间反映的是任务从提交到完成的耗时
+    static AdaptiveSpin& waitSpin();
+
+    std::atomic<int> _state{PENDING};
+};
+
+#endif // COMPLETION_H
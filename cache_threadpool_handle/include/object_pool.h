@@ -0,0 +1,37 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <cstddef>
+#include <new>
+#include "block_pool.h"
+
+//任务对象的内存池，固定大小的内存块由BlockPool管理（common/block_pool.h，线程池之间共用）
+//按64字节的整数倍划分大小等级，超过MAXPOOLEDSIZE或者对齐要求更高的类型直接使用new
+const size_t POOLBLOCKALIGN = 64;
+const size_t MAXPOOLEDSIZE = 1024;
+
+template<typename T>
+class ObjectPool {
+public:
+    static const size_t BLOCKSIZE = (sizeof(T) + POOLBLOCKALIGN - 1) / POOLBLOCKALIGN * POOLBLOCKALIGN;
+    static const bool POOLED = BLOCKSIZE <= MAXPOOLEDSIZE
+        && alignof(T) <= alignof(std::max_align_t);
+
+    static void* allocate()
+    {
+        if constexpr (POOLED)
+            return BlockPool<BLOCKSIZE>::Allocate();
+        else
+            return ::operator new(sizeof(T), std::align_val_t(alignof(T)));
+    }
+
+    static void deallocate(void* ptr)
+    {
+        if constexpr (POOLED)
+            BlockPool<BLOCKSIZE>::Deallocate(ptr);
+        else
+            ::operator delete(ptr, std::align_val_t(alignof(T)));
+    }
+};
+
+#endif // OBJECT_POOL_H
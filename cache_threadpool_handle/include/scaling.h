@@ -0,0 +1,58 @@
+#ifndef SCALING_H
+#define SCALING_H
+
+#include <chrono>
+#include <cstdint>
+
+//MODE_CACHED下伸缩控制器的配置
+struct ScalingConfig {
+    //活动线程数的下限，小于等于0时使用线程池的初始线程数
+    int minThreads = 0;
+    //线程总数的上限
+    int maxThreads = 200;
+    //期望的排队时延，任务从提交到开始执行的平均时间超过它就扩容
+    std::chrono::microseconds targetLatency{1000};
+    //平均排队时延低于targetLatency * shrinkRatio并且利用率低于shrinkUtilization时才缩容，
+    //两个阈值之间不做调整，避免线程数来回抖动
+    double shrinkRatio = 0.5;
+    double shrinkUtilization = 0.5;
+    //采样周期
+    std::chrono::milliseconds interval{10};
+    //距离上一次调整不足cooldown时不缩容，扩容不受限制，突发流量时可以及时响应
+    std::chrono::milliseconds cooldown{1000};
+};
+
+//控制器每个采样周期收集的数据
+struct ScalingSample {
+    int activeThreads;      //参与调度的线程数，不含停放的线程
+    int parkedThreads;      //缩容时停放的线程数，扩容时优先唤醒它们
+    int busyThreads;        //正在执行任务的线程数
+    int queuedTasks;        //排队中的任务数
+    double utilization;     //busyThreads / activeThreads
+    double arrivalRate;     //本周期每秒提交的任务数
+    double completionRate;  //本周期每秒开始执行的任务数
+    int64_t avgQueueWait;   //本周期出队任务的平均排队时间，单位纳秒
+    int64_t maxQueueWait;   //本周期出队任务的最大排队时间，单位纳秒
+};
+
+/*
+伸缩策略，根据采样数据给出期望的活动线程数
+控制器把结果限制在[minThreads, maxThreads]内，并负责冷却时间
+*/
+class ScalingPolicy {
+public:
+    virtual ~ScalingPolicy() = default;
+    virtual int decide(const ScalingSample& sample, const ScalingConfig& config) = 0;
+};
+
+/*
+默认策略，以排队时延为目标：
+排队时延超过目标，或者到达速率持续高于处理速率使得积压增长，就按超出的比例扩容；
+时延和利用率都低于缩容阈值时，每次去掉多余线程的一半
+*/
+class LatencyScalingPolicy : public ScalingPolicy {
+public:
+    int decide(const ScalingSample& sample, const ScalingConfig& config) override;
+};
+
+#endif // SCALING_H
@@ -8,9 +8,19 @@
 #include<future>
 #include<functional>
 #include<unordered_map>
-#include<queue>
+#include<vector>
+#include<chrono>
+#include<optional>
+#include<exception>
+#include<stdexcept>
+#include<type_traits>
 #include "any.h"
-#include "semaphore.h"
+#include "completion.h"
+#include "wait_strategy.h"
+#include "scaling.h"
+#include "mpmc_queue.h"
+#include "object_pool.h"
+#include "cancellation.h"
 
 //线程类型
 class Thread {
@@ -28,39 +38,343 @@ private:
     int _threadId;
 };
 
-//任务返回类型的声明
-class Result;
+//任务提交失败等线程池错误
+class TaskError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+//任务队列已满时的拒绝策略
+enum class RejectPolicy {
+    REJECT_ABORT,       //立即失败，trySubmit总是使用这个策略
+    REJECT_CALLER_RUNS, //在提交者线程上直接执行，提交者自然被减速
+    REJECT_DROP_OLDEST, //挤掉同一优先级中最早入队的任务，它的Result得到TaskRejected
+    REJECT_DROP_NEWEST, //丢弃新提交的任务
+    REJECT_BLOCK_TIMEOUT,//等待队列空位，超时后丢弃新提交的任务
+};
+const int REJECT_POLICIES = 5;
+
+//任务被拒绝或被挤出队列，没有执行，在获取结果时抛出
+class TaskRejected : public TaskError {
+public:
+    explicit TaskRejected(RejectPolicy policy);
+    RejectPolicy policy()const
+    {
+        return _policy;
+    }
+private:
+    RejectPolicy _policy;
+};
+
+template<typename T> class TaskPtr;
+
 //任务类型
 class Task {
 public:
-    Task();
-    ~Task() = default;
+    Task() = default;
+    virtual ~Task() = default;
     //提供给用户使用的可重写任务函数
     virtual Any run() = 0;
     //任务执行函数
-    void exec();
-    void setResult(Result* result);
+    virtual void exec();
+protected:
+    //通知等待结果的线程任务已经执行完毕
+    void finish();
+    //阻塞直到任务执行完毕
+    void waitFinish();
+    //任务是否已经执行完毕或被拒绝，只有一次原子读
+    bool finished()const;
+    //任务没有执行就被拒绝，通知等待结果的线程
+    void reject(RejectPolicy policy);
+    //任务被拒绝时抛出TaskRejected，需要在waitFinish之后调用
+    void throwIfRejected()const;
+    //出队时令牌已经取消，任务没有执行，通知等待结果的线程
+    void cancel();
+    //任务被取消时抛出TaskCancelled，需要在waitFinish之后调用
+    void throwIfCancelled()const;
+    //重新提交前清除上一次执行留下的返回值和异常
+    virtual void resetResult();
 private:
-    Result* _result;
+    friend class Result;
+    friend class ThreadPool;
+    template<typename> friend class TaskPtr;
+    template<typename T, typename... Args> friend TaskPtr<T> makeTask(Args&&... args);
+    /*
+    任务的返回值保存在任务对象自身中，而不是通过指针回写到Result里
+    任务入队后可能在Result构造完成之前就被工作线程取走执行，
+    保存在任务中就不存在Result尚未就绪的问题
+    */
+    Any _any;
+    //任务完成的通知，只有一个原子整数，结果就绪时查询只需一次原子读
+    Completion _done;
+    //任务是否被拒绝以及拒绝它的策略，在finish之前写入，waitFinish之后读取
+    bool _rejected = false;
+    RejectPolicy _rejectPolicy = RejectPolicy::REJECT_ABORT;
+    //提交时传入的取消令牌，工作线程出队时检查；默认构造的令牌不会被取消
+    CancellationToken _token;
+    //任务是否因令牌取消而没有执行，写入和读取的时机与_rejected相同
+    bool _cancelled = false;
+    //入队时间，MODE_CACHED下用于统计排队时延
+    int64_t _enqueueNanos = 0;
+    /*
+    侵入式引用计数，任务队列、工作线程和Result各持有一份
+    计数在0和1之间切换时（最后一次释放、通过shared_ptr重新提交）短暂置为REFBUSY，
+    期间其他线程等待，保证_owner不会被同时读写
+    */
+    static const int REFBUSY = -1;
+    std::atomic<int> _refCount{0};
+    //引用计数归零时调用：makeTask创建的任务析构后归还内存池，通过shared_ptr提交的任务释放_owner
+    void (*_release)(Task*) = nullptr;
+    //通过shared_ptr提交时持有自身，直到队列和Result都不再引用
+    std::shared_ptr<Task> _owner;
 };
 
+/*
+任务的侵入式智能指针，引用计数保存在Task内部，
+没有shared_ptr的控制块，复制和释放只是一次原子加减
+*/
+template<typename T>
+class TaskPtr {
+public:
+    TaskPtr() = default;
+    TaskPtr(std::nullptr_t) {}
+    //addRef为false时接管一份已经计入的引用
+    explicit TaskPtr(T* ptr, bool addRef = true) :_ptr(ptr)
+    {
+        if (addRef)
+            this->addRef();
+    }
+    TaskPtr(const TaskPtr& other) :_ptr(other._ptr)
+    {
+        addRef();
+    }
+    TaskPtr(TaskPtr&& other) noexcept :_ptr(other._ptr)
+    {
+        other._ptr = nullptr;
+    }
+    template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    TaskPtr(const TaskPtr<U>& other) :_ptr(other._ptr)
+    {
+        addRef();
+    }
+    template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    TaskPtr(TaskPtr<U>&& other) noexcept :_ptr(other._ptr)
+    {
+        other._ptr = nullptr;
+    }
+    ~TaskPtr()
+    {
+        release();
+    }
+    TaskPtr& operator=(TaskPtr other) noexcept
+    {
+        std::swap(_ptr, other._ptr);
+        return *this;
+    }
+
+    void reset()
+    {
+        release();
+        _ptr = nullptr;
+    }
+    T* get()const
+    {
+        return _ptr;
+    }
+    T* operator->()const
+    {
+        return _ptr;
+    }
+    T& operator*()const
+    {
+        return *_ptr;
+    }
+    explicit operator bool()const
+    {
+        return _ptr != nullptr;
+    }
+private:
+    template<typename> friend class TaskPtr;
+    void addRef()
+    {
+        if (_ptr)
+            static_cast<Task*>(_ptr)->_refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    void release()
+    {
+        Task* task = _ptr;
+        if (!task)
+            return;
+        int cur = task->_refCount.load(std::memory_order_relaxed);
+        while (true)
+        {
+            if (cur == 1)
+            {
+                //最后一个引用：先占住计数再调用_release，由_release负责把计数恢复为0
+                if (task->_refCount.compare_exchange_weak(cur, Task::REFBUSY, std::memory_order_acq_rel))
+                {
+                    task->_release(task);
+                    return;
+                }
+            }
+            else if (task->_refCount.compare_exchange_weak(cur, cur - 1, std::memory_order_acq_rel))
+            {
+                return;
+            }
+        }
+    }
+
+    T* _ptr = nullptr;
+};
+
+/*
+从内存池中创建任务，对象按大小等级从线程本地的空闲链表中分配，
+Result取走结果、工作线程执行完毕后归还，稳定运行时提交任务不再调用malloc/free
+*/
+template<typename T, typename... Args>
+TaskPtr<T> makeTask(Args&&... args)
+{
+    static_assert(std::is_base_of<Task, T>::value, "T must derive from Task");
+    void* mem = ObjectPool<T>::allocate();
+    T* task;
+    try
+    {
+        task = new (mem) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        ObjectPool<T>::deallocate(mem);
+        throw;
+    }
+    static_cast<Task*>(task)->_release = [](Task* base) {
+        T* derived = static_cast<T*>(base);
+        derived->~T();
+        ObjectPool<T>::deallocate(derived);
+    };
+    return TaskPtr<T>(task);
+}
+
 //任务的返回类型
 class Result {
 public:
-    Result(std::shared_ptr<Task> task, bool isValid = true);
+    Result(TaskPtr<Task> task, bool isValid = true);
     ~Result() = default;
-    //获取任务的返回值，提供给用户使用
+    //任务和返回值都保存在任务对象中，Result只持有引用，可以随意移动
+    Result(Result&&) = default;
+    Result& operator=(Result&&) = default;
+    //结果是否已经就绪，get不会阻塞
+    bool ready()const;
+    //提交时是否被拒绝，任务之后仍可能被REJECT_DROP_OLDEST挤出队列
+    bool isValid()const;
+    //获取任务的返回值，提供给用户使用，取走后释放对任务的引用
+    //任务被拒绝时抛出TaskRejected，被取消时抛出TaskCancelled
+    //只能调用一次，再次调用抛出TaskError
     Any get();
-    //设置任务的返回值，由任务执行函数调用
-    void setVal(Any any);
 private:
     //包装的任务
-    std::shared_ptr<Task> _taskPtr;
-    //封装的任务返回值
-    Any _any;
-    Semaphore _sem;
+    TaskPtr<Task> _taskPtr;
     //判断返回值是否有效
-    std::atomic<bool> _isValid;
+    bool _isValid;
+};
+
+/*
+带返回值类型的任务，用户重写call()
+返回值直接保存在任务对象内部，由TypedResult<R>移动取出，
+不需要Any的堆分配，也不需要dynamic_cast
+*/
+template<typename R>
+class TypedTask : public Task {
+public:
+    using result_type = R;
+    //提供给用户使用的可重写任务函数
+    virtual R call() = 0;
+    //通过旧接口submit(std::shared_ptr<Task>)提交时，返回值仍然封装为Any
+    Any run() override
+    {
+        if constexpr (std::is_void<R>::value) {
+            call();
+            return Any(0);
+        } else if constexpr (std::is_copy_constructible<R>::value) {
+            return Any(call());
+        } else {
+            throw TaskError("move-only result can only be read through TypedResult");
+        }
+    }
+    void exec() override
+    {
+        if (!_typed)
+        {
+            Task::exec();
+            return;
+        }
+        try
+        {
+            if constexpr (std::is_void<R>::value)
+                call();
+            else
+                _value.emplace(call());
+        }
+        catch (...)
+        {
+            _error = std::current_exception();
+        }
+        finish();
+    }
+protected:
+    void resetResult() override
+    {
+        Task::resetResult();
+        _value.reset();
+        _error = nullptr;
+    }
+private:
+    template<typename> friend class TypedResult;
+    friend class ThreadPool;
+    using Storage = typename std::conditional<std::is_void<R>::value, char, R>::type;
+    std::optional<Storage> _value;
+    //任务执行过程中抛出的异常，在get时重新抛出
+    std::exception_ptr _error;
+    //是否通过带类型的submit提交
+    bool _typed = false;
+};
+
+//带类型的任务返回值，可以移动
+template<typename R>
+class TypedResult {
+public:
+    TypedResult(TaskPtr<TypedTask<R>> task, bool isValid = true)
+        :_taskPtr(std::move(task)), _isValid(isValid) {}
+    TypedResult(TypedResult&&) = default;
+    TypedResult& operator=(TypedResult&&) = default;
+
+    bool isValid()const
+    {
+        return _isValid;
+    }
+    //结果是否已经就绪，get不会阻塞
+    bool ready()const
+    {
+        return _taskPtr && _taskPtr->finished();
+    }
+    //阻塞等待任务执行完毕并取出返回值，任务抛出的异常在这里重新抛出，
+    //被拒绝的任务抛出TaskRejected，被取消的任务抛出TaskCancelled
+    //只能调用一次，取走结果后释放对任务的引用，内存池中的任务随之回收
+    R get()
+    {
+        if (!_taskPtr)
+            throw TaskError("the result has already been retrieved");
+        TaskPtr<TypedTask<R>> task = std::move(_taskPtr);
+        task->waitFinish();
+        task->throwIfRejected();
+        task->throwIfCancelled();
+        if (task->_error)
+            std::rethrow_exception(task->_error);
+        if constexpr (!std::is_void<R>::value)
+            return std::move(*task->_value);
+    }
+private:
+    TaskPtr<TypedTask<R>> _taskPtr;
+    bool _isValid;
 };
 
 enum class PoolMode {
@@ -68,6 +382,22 @@ enum class PoolMode {
     MODE_CACHED,//线程数量动态增长
 };
 
+//任务优先级，数值越小优先级越高
+enum class TaskPriority {
+    PRIORITY_HIGH,  //延迟敏感的请求任务
+    PRIORITY_NORMAL,//默认优先级
+    PRIORITY_LOW,   //批量后台任务
+};
+const int PRIORITY_LEVELS = 3;
+
+//单个优先级队列的统计信息
+struct PriorityStats {
+    int depth;          //当前排队的任务数
+    uint64_t enqueued;  //累计入队的任务数
+    uint64_t dequeued;  //累计出队的任务数
+    uint64_t aged;      //因老化被提前调度的次数
+};
+
 class ThreadPool {
 public:
     ThreadPool(int initThreadSize = std::thread::hardware_concurrency());
@@ -75,12 +405,169 @@ public:
     ~ThreadPool();
     bool getThreadPoolState()const;
     void setMode(PoolMode poolMode);
+    /*
+    设置所有任务队列的总容量，需要在start之前调用
+    总容量平分给各个优先级，每个优先级的队列最多容纳maxSize/PRIORITY_LEVELS个任务（向上取整），
+    环形队列的容量还会向上取整为2的幂，因此实际的总容量可能略大于maxSize
+    */
     void setTaskQueueMaxSize(int maxSize);
     void start();
-    Result submit(std::shared_ptr<Task> taskPtr);
+    //队列已满时按setRejectPolicy设置的策略处理
+    Result submit(std::shared_ptr<Task> taskPtr, TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    //提交makeTask创建的任务，不经过shared_ptr的控制块
+    Result submit(TaskPtr<Task> taskPtr, TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    //提交带类型的任务，T需要继承自TypedTask<R>
+    template<typename T, typename R = typename T::result_type,
+        typename = typename std::enable_if<std::is_base_of<TypedTask<R>, T>::value>::type>
+    TypedResult<R> submit(std::shared_ptr<T> taskPtr, TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return submit(adoptShared(taskPtr), priority);
+    }
+    template<typename T, typename R = typename T::result_type,
+        typename = typename std::enable_if<std::is_base_of<TypedTask<R>, T>::value>::type>
+    TypedResult<R> submit(TaskPtr<T> taskPtr, TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return submitTyped<R>(std::move(taskPtr), priority, _rejectPolicy.load(std::memory_order_relaxed));
+    }
+    /*
+    可取消的提交：工作线程取出任务时令牌已经取消，任务不再执行，Result::get抛出TaskCancelled
+    提交时已经取消的任务不进入队列；执行中的任务可以自行检查token.IsCancelled()
+    */
+    Result submit(std::shared_ptr<Task> taskPtr, const CancellationToken& token,
+        TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    Result submit(TaskPtr<Task> taskPtr, const CancellationToken& token,
+        TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    template<typename T, typename R = typename T::result_type,
+        typename = typename std::enable_if<std::is_base_of<TypedTask<R>, T>::value>::type>
+    TypedResult<R> submit(std::shared_ptr<T> taskPtr, const CancellationToken& token,
+        TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return submit(adoptShared(taskPtr), token, priority);
+    }
+    template<typename T, typename R = typename T::result_type,
+        typename = typename std::enable_if<std::is_base_of<TypedTask<R>, T>::value>::type>
+    TypedResult<R> submit(TaskPtr<T> taskPtr, const CancellationToken& token,
+        TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return submitTyped<R>(std::move(taskPtr), priority, _rejectPolicy.load(std::memory_order_relaxed), token);
+    }
+    //队列已满时立即失败，不会阻塞，Result::isValid()返回false
+    Result trySubmit(std::shared_ptr<Task> taskPtr, TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    Result trySubmit(TaskPtr<Task> taskPtr, TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    template<typename T, typename R = typename T::result_type,
+        typename = typename std::enable_if<std::is_base_of<TypedTask<R>, T>::value>::type>
+    TypedResult<R> trySubmit(std::shared_ptr<T> taskPtr, TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return trySubmit(adoptShared(taskPtr), priority);
+    }
+    template<typename T, typename R = typename T::result_type,
+        typename = typename std::enable_if<std::is_base_of<TypedTask<R>, T>::value>::type>
+    TypedResult<R> trySubmit(TaskPtr<T> taskPtr, TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return submitTyped<R>(std::move(taskPtr), priority, RejectPolicy::REJECT_ABORT);
+    }
+    Result trySubmit(std::shared_ptr<Task> taskPtr, const CancellationToken& token,
+        TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    Result trySubmit(TaskPtr<Task> taskPtr, const CancellationToken& token,
+        TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    template<typename T, typename R = typename T::result_type,
+        typename = typename std::enable_if<std::is_base_of<TypedTask<R>, T>::value>::type>
+    TypedResult<R> trySubmit(std::shared_ptr<T> taskPtr, const CancellationToken& token,
+        TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return trySubmit(adoptShared(taskPtr), token, priority);
+    }
+    template<typename T, typename R = typename T::result_type,
+        typename = typename std::enable_if<std::is_base_of<TypedTask<R>, T>::value>::type>
+    TypedResult<R> trySubmit(TaskPtr<T> taskPtr, const CancellationToken& token,
+        TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return submitTyped<R>(std::move(taskPtr), priority, RejectPolicy::REJECT_ABORT, token);
+    }
+    /*
+    设置队列已满时submit的拒绝策略，运行期间也可以修改，默认等待1秒后丢弃
+    timeout只对REJECT_BLOCK_TIMEOUT有效
+    */
+    void setRejectPolicy(RejectPolicy policy, std::chrono::milliseconds timeout = std::chrono::seconds(1));
+    RejectPolicy getRejectPolicy()const;
+    //某个拒绝策略累计生效的次数，REJECT_DROP_OLDEST统计被挤出队列的任务数
+    uint64_t getRejectCount(RejectPolicy policy)const;
+    //因令牌取消而没有执行的任务数，包括提交时就已经取消的任务
+    uint64_t getCancelCount()const;
+    //获取某个优先级队列的统计信息
+    PriorityStats getPriorityStats(TaskPriority priority)const;
+    //设置空闲工作线程的等待策略，运行期间也可以修改
+    //等待任务结果的线程使用Completion::setWaitStrategy设置
+    void setWaitStrategy(const WaitStrategy& strategy);
+    WaitStrategy getWaitStrategy()const;
+    //MODE_CACHED下伸缩控制器的配置和策略，需要在start之前设置
+    void setScalingConfig(const ScalingConfig& config);
+    void setScalingPolicy(std::unique_ptr<ScalingPolicy> policy);
+    //控制器最近一次的采样
+    ScalingSample getScalingSample();
     void threadWork(int threadId);
 
 private:
+    /*
+    把通过shared_ptr提交的任务接入引用计数：任务持有自身的shared_ptr，
+    队列和Result都释放引用后再放开，用户手中的shared_ptr照常管理生命周期
+    */
+    template<typename T>
+    static TaskPtr<T> adoptShared(const std::shared_ptr<T>& taskPtr)
+    {
+        Task* task = taskPtr.get();
+        int cur = task->_refCount.load(std::memory_order_acquire);
+        while (true)
+        {
+            if (cur == Task::REFBUSY)
+            {
+                //上一次提交的最后一个引用正在释放
+                std::this_thread::yield();
+                cur = task->_refCount.load(std::memory_order_acquire);
+            }
+            else if (cur == 0)
+            {
+                if (task->_refCount.compare_exchange_weak(cur, Task::REFBUSY, std::memory_order_acquire))
+                {
+                    task->_owner = taskPtr;
+                    task->_release = [](Task* base) {
+                        //先移出来并恢复计数，再释放，任务可能随之析构
+                        std::shared_ptr<Task> owner = std::move(base->_owner);
+                        base->_refCount.store(0, std::memory_order_release);
+                    };
+                    task->_refCount.store(1, std::memory_order_release);
+                    break;
+                }
+            }
+            else if (task->_refCount.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        //上面已经计入了这一份引用
+        return TaskPtr<T>(static_cast<T*>(task), false);
+    }
+    template<typename R>
+    TypedResult<R> submitTyped(TaskPtr<TypedTask<R>> taskPtr, TaskPriority priority, RejectPolicy policy,
+        const CancellationToken& token = CancellationToken())
+    {
+        taskPtr->_typed = true;
+        bool isValid = enqueue(taskPtr, priority, policy, token);
+        return TypedResult<R>(std::move(taskPtr), isValid);
+    }
+    /*
+    将任务放入对应优先级的任务队列，队列已满时按policy处理，新任务被拒绝时返回false
+    token已经取消时不入队，直接以取消完成任务
+    */
+    bool enqueue(const TaskPtr<Task>& taskPtr, TaskPriority priority, RejectPolicy policy,
+        const CancellationToken& token = CancellationToken());
+    //令牌已经取消时以取消完成任务，返回是否取消
+    bool dropIfCancelled(const TaskPtr<Task>& taskPtr);
+    //把总容量maxSize平分给各个优先级，重新分配所有任务队列
+    void allocateQueues(int maxSize);
+    //按优先级从任务队列中取任务，所有队列都为空时返回false
+    bool popTask(TaskPtr<Task>& taskPtr);
+
     //线程队列
     //std::vector<std::unique_ptr<Thread>> _pool;
     std::unordered_map<int, std::unique_ptr<Thread>> _pool;
@@ -88,24 +575,79 @@ private:
     int _initThreadSize;
     //线程池中当前已经有的线程数,不能使用vector来获取，因为vector不是线程安全的
     std::atomic_int _curThreadSize;
-    //线程池中空闲的线程数
+    //线程池中空闲的线程数，包括停放的线程
     std::atomic_int _idleThreadSize;
+    //缩容后停放的线程数，这些线程不参与调度，扩容时优先唤醒
+    std::atomic_int _parkedThreads;
     //线程池中最大线程数
     int _maxThreadSize;
     PoolMode _poolMode;
 
-    //任务队列
-    std::queue<std::shared_ptr<Task>> _taskQ;
-    //当前任务队列中的任务数
+    /*
+    每个优先级一个无锁有界环形队列，各自分得setTaskQueueMaxSize设置的总容量的一份
+    工作线程总是先取高优先级的任务，低优先级队列每被跳过一次就累计一次，
+    累计到AGINGTHRESHOLD后优先调度一次，避免低优先级任务被饿死
+    */
+    struct alignas(64) PriorityLevel {
+        std::unique_ptr<MpmcQueue<TaskPtr<Task>>> queue;
+        std::atomic<int> depth{0};
+        std::atomic<int> skipped{0};
+        std::atomic<uint64_t> enqueued{0};
+        std::atomic<uint64_t> dequeued{0};
+        std::atomic<uint64_t> aged{0};
+    };
+    PriorityLevel _levels[PRIORITY_LEVELS];
+    //队列已满时等待空位，超时返回false
+    bool waitNotFull(PriorityLevel& level, const TaskPtr<Task>& taskPtr);
+    //挤出level中最早入队的任务
+    void evictOldest(PriorityLevel& level);
+    //队列已满时的拒绝策略及其统计
+    std::atomic<RejectPolicy> _rejectPolicy;
+    std::atomic<int64_t> _rejectTimeout;   //单位毫秒
+    std::atomic<uint64_t> _rejectCount[REJECT_POLICIES];
+    std::atomic<uint64_t> _cancelCount;
+    //当前所有任务队列中的任务总数
     std::atomic<int> _curTaskSize;
-    //任务队列的最大值
-    int _maxTaskSize;
+    /*
+    每个工作线程一个停车位，睡眠时只等待自己的条件变量，
+    提交者每个任务最多唤醒一个线程，不会把所有睡眠的线程都唤醒
+    */
+    struct Parker {
+        std::mutex mtx;
+        std::condition_variable cond;
+        bool notified = false;
+        //被控制器唤醒去停放，而不是去执行任务
+        bool reserve = false;
+        //等待被唤醒，返回是否需要停放
+        bool park();
+        void unpark(bool toReserve = false);
+    };
+    //把睡眠前的工作线程压入空闲栈
+    void pushIdle(Parker* parker);
+    //把自己从空闲栈中移除，已经被提交者取走时返回false，此时唤醒即将到来
+    bool removeIdle(Parker* parker);
+    //唤醒最近进入空闲的一个线程，它的缓存最热
+    void wakeOne();
+    //唤醒所有睡眠和停放的线程，关闭线程池时使用
+    void wakeAll();
+    //缩容后进入停放栈，直到扩容或关闭线程池才返回
+    void parkReserve(Parker* parker);
+
+    //睡眠的工作线程栈，后进先出
+    std::vector<Parker*> _idleStack;
+    //停放的线程栈，同样由_mtxIdle保护
+    std::vector<Parker*> _reserveStack;
+    std::mutex _mtxIdle;
+    //空闲栈中的线程数，为0时提交任务无需加锁唤醒
+    std::atomic<int> _waitingThreads;
+    //因队列已满而阻塞在_notFull上的提交者数
+    std::atomic<int> _waitingProducers;
+    //空闲工作线程睡眠前的自旋等待，自旋中的线程不计入_waitingThreads，提交者无需通知
+    AdaptiveSpin _idleSpin;
 
     /*锁资源*/
-    //互斥锁，用于保证任务队列的互斥性
+    //互斥锁，任务队列本身无锁，只在增删线程以及提交者等待队列空位时使用
     std::mutex _mtxPool;
-    //线程需要的条件变量
-    std::condition_variable _notEmpty;
     //任务队列需要的条件变量
     std::condition_variable _notFull;
 
@@ -114,5 +656,34 @@ private:
 
     //线程池的资源回收需要等到所有线程的资源回收后进行，因此需要一个条件变量进行通信控制
     std::condition_variable _condExit;
+
+    /*
+    MODE_CACHED下的伸缩控制器，在单独的线程上周期性采样并调整线程数，提交和执行任务的路径上只做计数
+    扩容先唤醒停放的线程，不够时再创建新线程；缩容把空闲栈底部最久没有运行的线程停放起来
+    */
+    void controllerWork();
+    ScalingSample collectSample(int64_t elapsedNanos);
+    void growThreads(int count);
+    void shrinkThreads(int count);
+    //创建并启动一个工作线程，需要持有_mtxPool
+    void createThread();
+
+    //出队任务的排队时延，控制器每个周期取走并清零
+    struct alignas(64) QueueWaitStats {
+        std::atomic<int64_t> sum{0};
+        std::atomic<int64_t> count{0};
+        std::atomic<int64_t> max{0};
+    };
+    QueueWaitStats _waitStats;
+    ScalingConfig _scalingConfig;
+    std::unique_ptr<ScalingPolicy> _scalingPolicy;
+    std::thread _controller;
+    std::mutex _mtxCtrl;
+    std::condition_variable _condCtrl;
+    bool _ctrlStop;
+    ScalingSample _lastSample;
+    //控制器上一次采样时的累计入队/出队数
+    uint64_t _lastEnqueued;
+    uint64_t _lastDequeued;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include<atomic>
+#include<chrono>
+#include<condition_variable>
+#include<cstdint>
+#include<memory>
+#include<mutex>
+#include<ostream>
+#include<thread>
+#include<vector>
+
+/*
+线程池的轻量级跟踪
+每个线程把定长的二进制事件写入自己的无锁环形缓冲区（单生产者单消费者），
+不会在工作线程里格式化字符串，也不会争用stdout的锁
+缓冲区写满时丢弃新事件并计数；由dump按需导出，或由后台线程定期导出
+
+编译期：定义THREADPOOL_TRACE才会编译跟踪点，未定义时TP_TRACE展开为空
+运行期：Tracer::enable(false)时每个跟踪点只有一次relaxed读
+*/
+
+enum class TraceEvent : uint16_t {
+    THREAD_START,   //工作线程启动
+    THREAD_EXIT,    //工作线程退出，arg：0线程池关闭
+    THREAD_CREATE,  //cached模式下扩容创建线程，arg：新线程id
+    TASK_WAIT,      //任务队列为空，线程进入等待
+    TASK_DEQUEUE,   //取到任务，arg：队列中剩余任务数
+    TASK_DONE,      //任务执行结束
+    QUEUE_FULL,     //任务队列已满，arg：拒绝策略
+    POOL_EXIT,      //线程池析构完成
+    TASK_REJECT,    //任务被拒绝策略处理，arg：拒绝策略
+    TASK_CANCEL,    //任务的取消令牌已经取消，没有执行
+};
+
+const char* traceEventName(TraceEvent event);
+
+//一条跟踪记录
+struct TraceRecord {
+    uint64_t timestamp;  //steady_clock纳秒
+    int32_t threadId;    //线程池内的线程id，非工作线程为-1
+    TraceEvent event;
+    uint16_t reserved;
+    uint64_t arg;
+};
+
+//单个线程的跟踪缓冲区，只有所属线程写入，导出时由Tracer加锁读取
+class TraceBuffer {
+public:
+    static const size_t CAPACITY = 4096;
+
+    TraceBuffer();
+    TraceBuffer(const TraceBuffer&) = delete;
+    TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+    void push(const TraceRecord& record)
+    {
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= CAPACITY)
+        {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        _records[head & (CAPACITY - 1)] = record;
+        _head.store(head + 1, std::memory_order_release);
+    }
+
+    //取出所有已写入的记录
+    void drain(std::vector<TraceRecord>& out);
+    uint64_t dropped()const;
+    bool empty()const;
+
+    //所属线程已经退出，缓冲区读空后可以回收
+    std::atomic<bool> retired;
+private:
+    std::unique_ptr<TraceRecord[]> _records;
+    alignas(64) std::atomic<uint64_t> _head;
+    alignas(64) std::atomic<uint64_t> _tail;
+    std::atomic<uint64_t> _dropped;
+};
+
+class Tracer {
+public:
+    static bool enabled()
+    {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+    static void enable(bool on);
+
+    //记录一个事件，写入当前线程的缓冲区
+    static void record(TraceEvent event, int threadId, uint64_t arg = 0);
+
+    //导出所有线程缓冲区中的事件，按时间排序格式化输出，返回导出的事件数
+    static size_t dump(std::ostream& os);
+
+    //启动后台线程，每隔interval导出一次；再次调用会先停止之前的线程
+    static void startDrainer(std::ostream& os, std::chrono::milliseconds interval);
+    static void stopDrainer();
+
+private:
+    static std::shared_ptr<TraceBuffer> localBuffer();
+
+    static std::atomic<bool> _enabled;
+};
+
+#ifdef THREADPOOL_TRACE
+#define TP_TRACE(event, threadId, arg) \
+    do { \
+        if (Tracer::enabled()) \
+            Tracer::record((event), (threadId), (arg)); \
+    } while (0)
+#else
+#define TP_TRACE(event, threadId, arg) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef WAIT_STRATEGY_H
+#define WAIT_STRATEGY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+//等待方式
+enum class WaitMode {
+    WAIT_BLOCK,   //直接在条件变量上睡眠
+    WAIT_SPIN,    //先自旋spinMicros、再让出CPU yieldMicros，之后才睡眠
+    WAIT_ADAPTIVE,//同WAIT_SPIN，但自旋时长根据最近的等待时间自动调整
+};
+
+//等待策略，spinMicros和yieldMicros是自旋和让出CPU两个阶段的时长上限
+struct WaitStrategy {
+    WaitMode mode = WaitMode::WAIT_ADAPTIVE;
+    int spinMicros = 50;
+    int yieldMicros = 50;
+};
+
+//自旋等待时提示CPU当前处于忙等，降低功耗并让出超线程的执行资源
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/*
+睡眠前的自旋等待
+睡眠/唤醒一次要经过futex系统调用和调度器，耗时在几十微秒量级，
+而任务间隔很短时，等待的条件往往在几微秒内就会满足
+自适应模式下记录每次等待实际花费的时间并做指数平滑：
+最近的等待都很短，说明任务到达得很密集，自旋到平均等待时间的两倍；
+最近的等待都很长，说明处于空闲期，自旋只会浪费CPU，直接睡眠
+*/
+class AdaptiveSpin {
+public:
+    AdaptiveSpin() = default;
+    AdaptiveSpin(const AdaptiveSpin&) = delete;
+    AdaptiveSpin& operator=(const AdaptiveSpin&) = delete;
+
+    void setStrategy(const WaitStrategy& strategy);
+    WaitStrategy getStrategy()const;
+
+    //记录一次等待从开始到条件满足实际花费的时间，包括睡眠的时间
+    void recordWait(int64_t nanos);
+    //最近等待时间的平滑值
+    int64_t averageWait()const;
+
+    static int64_t nowNanos()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /*
+    自旋、让出CPU直到ready()返回true，成功返回true
+    超出预算仍未满足时返回false，调用者接着走睡眠的路径
+    ready()会被反复调用，应当先做廉价的检查
+    */
+    template<typename Pred>
+    bool wait(Pred&& ready)
+    {
+        int64_t spinNanos = 0;
+        int64_t yieldNanos = 0;
+        budget(spinNanos, yieldNanos);
+        if (spinNanos == 0 && yieldNanos == 0)
+            return false;
+        int64_t start = nowNanos();
+        int64_t elapsed = 0;
+        //每自旋一小段才读一次时钟
+        while (elapsed < spinNanos)
+        {
+            for (int i = 0; i < 64; i++)
+            {
+                if (ready())
+                {
+                    recordWait(nowNanos() - start);
+                    return true;
+                }
+                cpuRelax();
+            }
+            elapsed = nowNanos() - start;
+        }
+        while (elapsed < spinNanos + yieldNanos)
+        {
+            if (ready())
+            {
+                recordWait(nowNanos() - start);
+                return true;
+            }
+            std::this_thread::yield();
+            elapsed = nowNanos() - start;
+        }
+        return false;
+    }
+
+private:
+    //计算本次等待的自旋和让出CPU的时长
+    void budget(int64_t& spinNanos, int64_t& yieldNanos)const;
+
+    std::atomic<int> _mode{static_cast<int>(WaitMode::WAIT_ADAPTIVE)};
+    std::atomic<int64_t> _spinNanos{50000};
+    std::atomic<int64_t> _yieldNanos{50000};
+    //最近等待时间的指数平滑值，多个线程并发更新时允许丢失个别样本
+    std::atomic<int64_t> _avgWait{50000};
+};
+
+#endif // WAIT_STRATEGY_H
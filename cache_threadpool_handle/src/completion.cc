@@ -0,0 +1,104 @@
+#include "completion.h"
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#endif
+
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex needs a plain 32-bit word");
+
+#ifdef __linux__
+//state仍等于expected时睡眠，被唤醒或者值已经改变时返回，可能虚假唤醒
+static void futexWait(std::atomic<int>& state, int expected)
+{
+    syscall(SYS_futex, reinterpret_cast<int*>(&state), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+static void futexWakeAll(std::atomic<int>& state)
+{
+    syscall(SYS_futex, reinterpret_cast<int*>(&state), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+#else
+//没有futex时按地址分桶，每个桶一把锁和一个条件变量，由落在同一个桶里的完成标志共用
+struct WaitBucket {
+    std::mutex mtx;
+    std::condition_variable cond;
+};
+
+static WaitBucket& bucketOf(const void* addr)
+{
+    static WaitBucket buckets[64];
+    return buckets[(reinterpret_cast<uintptr_t>(addr) >> 4) % 64];
+}
+
+static void futexWait(std::atomic<int>& state, int expected)
+{
+    WaitBucket& bucket = bucketOf(&state);
+    std::unique_lock<std::mutex> lock(bucket.mtx);
+    bucket.cond.wait(lock, [&]() { return state.load(std::memory_order_acquire) != expected; });
+}
+
+static void futexWakeAll(std::atomic<int>& state)
+{
+    WaitBucket& bucket = bucketOf(&state);
+    std::lock_guard<std::mutex> lock(bucket.mtx);
+    bucket.cond.notify_all();
+}
+#endif
+
+AdaptiveSpin& Completion::waitSpin()
+{
+    static AdaptiveSpin spin;
+    return spin;
+}
+
+void Completion::setWaitStrategy(const WaitStrategy& strategy)
+{
+    waitSpin().setStrategy(strategy);
+}
+
+WaitStrategy Completion::getWaitStrategy()
+{
+    return waitSpin().getStrategy();
+}
+
+void Completion::complete()
+{
+    //只有等待者把状态改成了WAITING才需要系统调用
+    if (_state.exchange(DONE, std::memory_order_acq_rel) == WAITING)
+        futexWakeAll(_state);
+}
+
+void Completion::wait()
+{
+    if (isDone())
+        return;
+    //先自旋等待，结果很快就绪时不必经过睡眠/唤醒
+    AdaptiveSpin& spin = waitSpin();
+    int64_t start = AdaptiveSpin::nowNanos();
+    if (spin.wait([this]() { return isDone(); }))
+        return;
+
+    int cur = _state.load(std::memory_order_acquire);
+    while (cur != DONE)
+    {
+        //先登记等待者再睡眠，complete看到WAITING才会唤醒；状态已经变化时futex立即返回
+        if (cur == WAITING || _state.compare_exchange_weak(cur, WAITING, std::memory_order_acquire))
+        {
+            futexWait(_state, WAITING);
+            cur = _state.load(std::memory_order_acquire);
+        }
+    }
+    spin.recordWait(AdaptiveSpin::nowNanos() - start);
+}
+
+void Completion::reset()
+{
+    int expected = DONE;
+    _state.compare_exchange_strong(expected, PENDING, std::memory_order_relaxed);
+}
@@ -1,6 +1,9 @@
 #include"threadpool.h"
+#include"trace.h"
 #include<chrono>
 #include<iostream>
+#include<stdexcept>
+#include<vector>
 class MyTask :public Task
 {
 public:
@@ -49,8 +52,242 @@ void test()
 #endif
 }
 
+//带类型的任务，返回值不经过Any
+class SumTask :public TypedTask<long long>
+{
+public:
+    SumTask(int begin, int end) :_begin(begin), _end(end) {}
+    long long call() override
+    {
+        long long sum = 0;
+        for (int i = _begin; i < _end; i++)
+            sum += i;
+        return sum;
+    }
+private:
+    int _begin;
+    int _end;
+};
+
+//第一次执行抛出异常，之后每次返回执行的次数，用来演示重新提交
+class FlakyTask :public TypedTask<int>
+{
+public:
+    int call() override
+    {
+        if (_runs++ == 0)
+            throw std::runtime_error("first run failed");
+        return _runs;
+    }
+private:
+    int _runs = 0;
+};
+
+void typedTest()
+{
+    ThreadPool pool(2);
+    pool.start();
+    TypedResult<long long> res1 = pool.submit(std::make_shared<SumTask>(1, 10000));
+    //makeTask从内存池创建任务，结果取走后任务归还内存池
+    TypedResult<long long> res2 = pool.submit(makeTask<SumTask>(10000, 20000));
+    std::cout << "typed sum=" << (res1.get() + res2.get()) << std::endl;
+
+    //同一个任务失败后重新提交，上一次的异常不会再被抛出
+    auto flaky = std::make_shared<FlakyTask>();
+    try
+    {
+        pool.submit(flaky).get();
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cout << "typed first run: " << e.what() << std::endl;
+    }
+    std::cout << "typed resubmit=" << pool.submit(flaky).get() << std::endl;
+}
+
+void priorityTest()
+{
+    //单个线程时更容易看出调度顺序：先提交的批量任务排在后提交的高优先级任务之后
+    ThreadPool pool(1);
+    pool.start();
+    std::vector<TypedResult<long long>> results;
+    for (int i = 0; i < 16; i++)
+        results.push_back(pool.submit(std::make_shared<SumTask>(0, 100000), TaskPriority::PRIORITY_LOW));
+    for (int i = 0; i < 16; i++)
+        results.push_back(pool.submit(std::make_shared<SumTask>(0, 10), TaskPriority::PRIORITY_HIGH));
+    for (auto& res : results)
+        res.get();
+    PriorityStats high = pool.getPriorityStats(TaskPriority::PRIORITY_HIGH);
+    PriorityStats low = pool.getPriorityStats(TaskPriority::PRIORITY_LOW);
+    std::cout << "high: dequeued=" << high.dequeued << " depth=" << high.depth << std::endl;
+    std::cout << "low: dequeued=" << low.dequeued << " depth=" << low.depth << " aged=" << low.aged << std::endl;
+}
+
+//逐个提交短任务并等待结果，比较不同等待策略下一次往返的平均耗时
+void waitStrategyTest()
+{
+    WaitMode modes[] = { WaitMode::WAIT_BLOCK, WaitMode::WAIT_ADAPTIVE };
+    const char* names[] = { "block", "adaptive" };
+    for (int m = 0; m < 2; m++)
+    {
+        WaitStrategy strategy;
+        strategy.mode = modes[m];
+        Completion::setWaitStrategy(strategy);
+        ThreadPool pool(2);
+        pool.setWaitStrategy(strategy);
+        pool.start();
+        const int rounds = 2000;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++)
+            pool.submit(std::make_shared<SumTask>(0, 10)).get();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+        std::cout << names[m] << " round trip=" << (double)us / rounds << "us" << std::endl;
+    }
+    Completion::setWaitStrategy(WaitStrategy());
+}
+
+//阻塞型任务堆积时控制器扩容，空闲后缩容，多出来的线程停放起来，下一次扩容直接唤醒
+class SleepTask :public TypedTask<int>
+{
+public:
+    int call() override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return 1;
+    }
+};
+
+void scalingTest()
+{
+    ThreadPool pool(2);
+    pool.setMode(PoolMode::MODE_CACHED);
+    ScalingConfig config;
+    config.maxThreads = 32;
+    config.targetLatency = std::chrono::milliseconds(5);
+    config.cooldown = std::chrono::milliseconds(100);
+    pool.setScalingConfig(config);
+    pool.start();
+    for (int round = 0; round < 2; round++)
+    {
+        std::vector<TypedResult<int>> results;
+        for (int i = 0; i < 200; i++)
+            results.push_back(pool.submit(std::make_shared<SleepTask>()));
+        for (auto& res : results)
+            res.get();
+        ScalingSample busy = pool.getScalingSample();
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        ScalingSample idle = pool.getScalingSample();
+        std::cout << "round " << round << ": busy active=" << busy.activeThreads
+            << " parked=" << busy.parkedThreads
+            << ", idle active=" << idle.activeThreads
+            << " parked=" << idle.parkedThreads << std::endl;
+    }
+}
+
+//队列很小时比较各个拒绝策略，被拒绝或被挤出队列的任务在get时抛出TaskRejected
+void rejectTest()
+{
+    RejectPolicy policies[] = { RejectPolicy::REJECT_ABORT, RejectPolicy::REJECT_CALLER_RUNS,
+        RejectPolicy::REJECT_DROP_OLDEST, RejectPolicy::REJECT_DROP_NEWEST, RejectPolicy::REJECT_BLOCK_TIMEOUT };
+    const char* names[] = { "abort", "caller_runs", "drop_oldest", "drop_newest", "block_timeout" };
+    for (int p = 0; p < REJECT_POLICIES; p++)
+    {
+        ThreadPool pool(1);
+        pool.setTaskQueueMaxSize(4);
+        pool.setRejectPolicy(policies[p], std::chrono::milliseconds(1));
+        pool.start();
+        std::vector<TypedResult<int>> results;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < 16; i++)
+        {
+            //REJECT_ABORT通过trySubmit演示，其余策略由submit使用
+            if (policies[p] == RejectPolicy::REJECT_ABORT)
+                results.push_back(pool.trySubmit(makeTask<SleepTask>()));
+            else
+                results.push_back(pool.submit(makeTask<SleepTask>()));
+        }
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+        int done = 0;
+        int rejected = 0;
+        for (auto& res : results)
+        {
+            try
+            {
+                done += res.get();
+            }
+            catch (const TaskRejected&)
+            {
+                rejected++;
+            }
+        }
+        std::cout << names[p] << ": submit=" << us << "us done=" << done << " rejected=" << rejected
+            << " count=" << pool.getRejectCount(policies[p]) << std::endl;
+    }
+}
+
+void cancelTest()
+{
+    ThreadPool pool(1);
+    pool.start();
+    CancellationSource request;
+    CancellationSource other;
+    //单线程的池先被一个任务占住，后面的任务都在排队
+    TypedResult<int> running = pool.submit(makeTask<SleepTask>());
+    std::vector<TypedResult<int>> queued;
+    for (int i = 0; i < 8; i++)
+        queued.push_back(pool.submit(makeTask<SleepTask>(), request.Token()));
+    Result legacy = pool.trySubmit(std::make_shared<MyTask>(1, 100), request.Token());
+    TypedResult<int> unrelated = pool.submit(makeTask<SleepTask>(), other.Token());
+    request.Cancel();
+    //提交时已经取消的任务不进入队列
+    TypedResult<int> late = pool.submit(makeTask<SleepTask>(), request.Token());
+
+    int done = running.get() + unrelated.get();
+    int cancelled = 0;
+    for (auto& res : queued)
+    {
+        try
+        {
+            done += res.get();
+        }
+        catch (const TaskCancelled&)
+        {
+            cancelled++;
+        }
+    }
+    try
+    {
+        legacy.get();
+    }
+    catch (const TaskCancelled&)
+    {
+        cancelled++;
+    }
+    try
+    {
+        late.get();
+    }
+    catch (const TaskCancelled&)
+    {
+        cancelled++;
+    }
+    std::cout << "cancel: done=" << done << " cancelled=" << cancelled
+        << " count=" << pool.getCancelCount() << std::endl;
+}
+
 int main()
 {
+    //打开跟踪，线程池的调度事件在结束时统一输出
+    Tracer::enable(true);
     test();
+    typedTest();
+    priorityTest();
+    waitStrategyTest();
+    scalingTest();
+    rejectTest();
+    cancelTest();
+    Tracer::dump(std::cout);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "scaling.h"
+#include <algorithm>
+#include <cmath>
+
+int LatencyScalingPolicy::decide(const ScalingSample& sample, const ScalingConfig& config)
+{
+    int active = std::max(sample.activeThreads, 1);
+    double target = static_cast<double>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(config.targetLatency).count());
+    if (target <= 0)
+        target = 1;
+
+    /*
+    任务都堵在队列里时没有出队样本，用积压量除以处理速率估计排队时间
+    处理速率为0说明所有线程都被长任务占住，只要有积压就视为超时
+    */
+    double wait = static_cast<double>(sample.avgQueueWait);
+    if (sample.queuedTasks > 0)
+    {
+        double backlog = sample.completionRate > 0
+            ? sample.queuedTasks / sample.completionRate * 1e9
+            : target * 2;
+        wait = std::max(wait, backlog);
+    }
+
+    bool backlogGrowing = sample.queuedTasks > 0
+        && sample.arrivalRate > sample.completionRate * 1.1;
+    if (wait > target || backlogGrowing)
+    {
+        //按超出目标的比例扩容，一次最多翻倍，也不超过排队的任务数
+        double ratio = std::max(wait / target - 1.0, 0.0);
+        int grow = static_cast<int>(std::ceil(active * std::min(ratio, 1.0)));
+        grow = std::max(grow, 1);
+        if (sample.queuedTasks > 0)
+            grow = std::min(grow, sample.queuedTasks);
+        return active + grow;
+    }
+    if (wait < target * config.shrinkRatio
+        && sample.utilization < config.shrinkUtilization
+        && sample.arrivalRate <= sample.completionRate)
+    {
+        //利用率回到缩容阈值所需的线程数，每次只去掉多余部分的一半
+        int needed = static_cast<int>(std::ceil(sample.busyThreads / std::max(config.shrinkUtilization, 0.01)));
+        int surplus = active - needed;
+        if (surplus > 0)
+            return active - std::max(surplus / 2, 1);
+    }
+    return active;
+}
@@ -1,8 +1,14 @@
 #include "threadpool.h"
+#include "trace.h"
 #include<climits>
-const int TASKMAXSIZE = INT_MAX;
+#include<algorithm>
+#include<utility>
+//任务队列需要预先分配所有槽位，默认容量不能再使用INT_MAX
+//这是所有优先级队列的总容量，每个优先级分得1024个槽位
+const int TASKMAXSIZE = 1024 * PRIORITY_LEVELS;
 const int THREADMAXSIZE = 200;
-const int IDLEMAXTIME = 60;//单位/秒
+//低优先级队列被高优先级任务跳过的次数达到该值后，优先调度一次
+const int AGINGTHRESHOLD = 8;
 
 int Thread::_genertedId = 0;
 Thread::Thread(threadWork threadfunc)
@@ -23,22 +29,46 @@ ThreadPool::ThreadPool(int initThreadSize)
     :_initThreadSize(initThreadSize),
     _curThreadSize(initThreadSize),
     _idleThreadSize(0),
+    _parkedThreads(0),
     _maxThreadSize(THREADMAXSIZE),
+    _poolMode(PoolMode::MODE_FIXED),
+    _rejectPolicy(RejectPolicy::REJECT_BLOCK_TIMEOUT),
+    _rejectTimeout(1000),
+    _cancelCount(0),
     _curTaskSize(0),
-    _maxTaskSize(TASKMAXSIZE),
-    _poolMode(PoolMode::MODE_FIXED)
-{}
+    _waitingThreads(0),
+    _waitingProducers(0),
+    _isRunning(false),
+    _scalingPolicy(std::make_unique<LatencyScalingPolicy>()),
+    _ctrlStop(false),
+    _lastSample(),
+    _lastEnqueued(0),
+    _lastDequeued(0)
+{
+    allocateQueues(TASKMAXSIZE);
+    for (auto& count : _rejectCount)
+        count = 0;
+}
 
 ThreadPool::~ThreadPool() 
 {
+    //先停止伸缩控制器，之后线程数不再变化
+    {
+        std::lock_guard<std::mutex> lock(_mtxCtrl);
+        _ctrlStop = true;
+    }
+    _condCtrl.notify_all();
+    if (_controller.joinable())
+        _controller.join();
     //关闭线程池
     _isRunning = false;
-    /*唤醒所有等待在_notEmpty条件上的线程*/
-    //等待在_notEmpty条件上的线程有两种，一种是正在执行任务的线程，一种是阻塞等待任务执行的线程
+    /*唤醒所有睡眠和停放的线程*/
+    //正在执行任务的线程执行完后会在压入空闲栈之后看到关闭标志，不会再睡眠
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wakeAll();
     std::unique_lock<std::mutex> lock(_mtxPool);
-    _notEmpty.notify_all();
     _condExit.wait(lock, [&]()->bool { return _pool.size() == 0; });
-    std::cout << "threadPool exit!" << std::endl;
+    TP_TRACE(TraceEvent::POOL_EXIT, -1, 0);
 }
 bool ThreadPool::getThreadPoolState()const
 {
@@ -53,12 +83,46 @@ void ThreadPool::setMode(PoolMode poolMode) {
 void ThreadPool::setTaskQueueMaxSize(int maxSize) {
     if (getThreadPoolState())
         return;
-    _maxTaskSize = maxSize;
+    //线程池启动前队列中还没有任务，按新的容量重新分配
+    allocateQueues(maxSize);
+}
+
+void ThreadPool::allocateQueues(int maxSize)
+{
+    int perLevel = (std::max(maxSize, 1) + PRIORITY_LEVELS - 1) / PRIORITY_LEVELS;
+    for (auto& level : _levels)
+        level.queue = std::make_unique<MpmcQueue<TaskPtr<Task>>>(perLevel);
+}
+
+void ThreadPool::setScalingConfig(const ScalingConfig& config)
+{
+    if (getThreadPoolState())
+        return;
+    _scalingConfig = config;
+}
+
+void ThreadPool::setScalingPolicy(std::unique_ptr<ScalingPolicy> policy)
+{
+    if (getThreadPoolState() || !policy)
+        return;
+    _scalingPolicy = std::move(policy);
+}
+
+ScalingSample ThreadPool::getScalingSample()
+{
+    std::lock_guard<std::mutex> lock(_mtxCtrl);
+    return _lastSample;
 }
 
 void ThreadPool::start()
 {
     _isRunning = true;
+    if (_poolMode == PoolMode::MODE_CACHED)
+    {
+        if (_scalingConfig.minThreads <= 0)
+            _scalingConfig.minThreads = _initThreadSize;
+        _maxThreadSize = std::max(_scalingConfig.maxThreads, _initThreadSize);
+    }
     for (int i = 0; i < _initThreadSize; i++)
     {
         auto threadPtr = std::make_unique<Thread>(std::bind(&ThreadPool::threadWork, this, std::placeholders::_1));
@@ -73,157 +137,599 @@ void ThreadPool::start()
         //启动任务，但并没有执行任务，属于空闲线程
         _idleThreadSize++;
     }
+    if (_poolMode == PoolMode::MODE_CACHED)
+        _controller = std::thread(&ThreadPool::controllerWork, this);
 }
 
 void ThreadPool::threadWork(int threadId)
 {
-    //记录线程空闲时的起始时间戳
-    auto lasttime = std::chrono::high_resolution_clock().now();
+    TP_TRACE(TraceEvent::THREAD_START, threadId, 0);
+    //本线程的停车位，睡眠期间挂在空闲栈上
+    Parker parker;
     while(1)
     {
-        std::shared_ptr<Task> taskPtr;
+        TaskPtr<Task> taskPtr;
+        //快速路径：直接从无锁队列中取任务，不需要加锁
+        //队列为空时先按等待策略自旋一段时间，任务很快到来时省去一次睡眠/唤醒
+        if (!popTask(taskPtr)
+            && !_idleSpin.wait([&]() { return _curTaskSize.load(std::memory_order_relaxed) > 0 && popTask(taskPtr); }))
         {
-            std::unique_lock<std::mutex> lock(_mtxPool);
-            std::cout << threadId << " [" << std::this_thread::get_id() << "] 尝试获取任务..." << std::endl;
+            int64_t parkStart = AdaptiveSpin::nowNanos();
+            TP_TRACE(TraceEvent::TASK_WAIT, threadId, 0);
             /*
-            阻塞的线程被唤醒有两种情况，分别是被任务队列唤醒，表示需要执行任务
+            阻塞的线程被唤醒有两种情况，分别是被提交者唤醒，表示需要执行任务
             一种是线程池已经关闭，需要清理线程，判别这两种情况的办法就是看线程池的关闭标志
             */
-            while(_curTaskSize==0)
+            while (true)
             {
+                /*
+                先压入空闲栈再重新检查队列，提交者入队后会检查空闲栈中的线程数，
+                两边都使用seq_cst屏障，保证要么这里能取到任务，要么提交者能看到这个线程并唤醒它
+                */
+                pushIdle(&parker);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (popTask(taskPtr))
+                {
+                    /*
+                    已经被提交者或控制器取出栈时，唤醒马上就会到来，在这里等它完成，
+                    否则唤醒可能在线程退出、停车位销毁之后才到达
+                    这次唤醒如果是让线程停放，就先执行取到的任务，下一个采样周期控制器会重新缩容
+                    */
+                    if (!removeIdle(&parker))
+                        parker.park();
+                    break;
+                }
                 if (!_isRunning)
                 {
+                    //析构函数已经把这个线程取出栈时，必须等它唤醒完才能销毁停车位
+                    if (!removeIdle(&parker))
+                        parker.park();
                     /*如果线程池已经关闭,需要清理线程资源，并通知线程池的析构函数，释放线程池*/
-                    //关闭线程池后清理执行任务后的线程
-                    _pool.erase(threadId);
+                    //从_pool中移除后析构函数就可能返回，之后不能再访问线程池
+                    std::lock_guard<std::mutex> lock(_mtxPool);
                     _curThreadSize--;
                     _idleThreadSize--;
-                    std::cout<<threadId<<"[" << std::this_thread::get_id() << "]exit!" << std::endl;
+                    _pool.erase(threadId);
+                    TP_TRACE(TraceEvent::THREAD_EXIT, threadId, 0);
                     //线程清理完毕，通知线程池（析构函数）可以关闭了
                     _condExit.notify_all();
                     return;
                 }
-                if (_poolMode == PoolMode::MODE_CACHED)
-                {
-                    /*
-                    等待在_notEmpty条件上的线程，有可能是在等待执行任务的线程，也有可能是确实空闲下来的线程
-                    区别这两种线程的办法就是，每隔1s就判断等待在_notEmpty条件上的线程的时间是否超过60s
-                    如果空闲时间超过了60s，并且线程池中的线程数超过初始线程数，就将该线程清理掉
-                    */
-                    //等待在_notEmpty条件上的线程在1s内如果被通知就不是超时的，否则就是超时了
-                    if (std::cv_status::timeout == _notEmpty.wait_for(lock, std::chrono::seconds(1)))
-                    {
-                        auto now = std::chrono::high_resolution_clock().now();
-                        //空闲时间
-                        auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lasttime);
-                        if (dur.count() >= IDLEMAXTIME && _curThreadSize>_initThreadSize)
-                        {
-                            _pool.erase(threadId);
-                            _curThreadSize--;
-                            _idleThreadSize--;
-                            std::cout << std::this_thread::get_id() << "exit!" << std::endl;
-                            return;
-                        }
-                    }
-                }else {//FIXED模式
-                    //只有当队列不空的条件下才继续向下执行，否则就阻塞
-                    _notEmpty.wait(lock);
-                }
+                //被唤醒时已经不在空闲栈中；控制器缩容时会让这个线程转去停放
+                if (parker.park())
+                    parkReserve(&parker);
             }
+            _idleSpin.recordWait(AdaptiveSpin::nowNanos() - parkStart);
+        }
 
-            /*取出任务*/
-            taskPtr = _taskQ.front();
-            _taskQ.pop();
-            _curTaskSize--;
-            std::cout<< threadId << " [" << std::this_thread::get_id() << "]获取任务成功..." << std::endl;
-            //如果取出一个任务之后仍旧有其他任务，就继续通知其他线程继续取出任务
-            if (_curTaskSize > 0)
-                _notEmpty.notify_all();
-            _notFull.notify_all();
+        /*取出任务*/
+        //关闭跟踪时TP_TRACE展开为空，remain只在跟踪点中使用
+        [[maybe_unused]] int remain = --_curTaskSize;
+        if (_poolMode == PoolMode::MODE_CACHED && taskPtr)
+        {
+            //排队时延，交给伸缩控制器采样
+            int64_t wait = AdaptiveSpin::nowNanos() - taskPtr->_enqueueNanos;
+            _waitStats.sum.fetch_add(wait, std::memory_order_relaxed);
+            _waitStats.count.fetch_add(1, std::memory_order_relaxed);
+            int64_t max = _waitStats.max.load(std::memory_order_relaxed);
+            while (wait > max && !_waitStats.max.compare_exchange_weak(max, wait, std::memory_order_relaxed))
+                ;
+        }
+        TP_TRACE(TraceEvent::TASK_DEQUEUE, threadId, remain);
+        //只有存在因队列已满而阻塞的提交者时才需要加锁通知
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        //每取出一个任务只空出一个槽位，唤醒一个提交者即可
+        if (_waitingProducers > 0)
+        {
+            std::lock_guard<std::mutex> lock(_mtxPool);
+            _notFull.notify_one();
         }
 
-        //执行任务
-        if (taskPtr)
+        //执行任务，出队时令牌已经取消的任务不再执行
+        if (taskPtr && !dropIfCancelled(taskPtr))
         {
             //开始执行任务，空闲线程数减1
             _idleThreadSize--;
             taskPtr->exec();
+            TP_TRACE(TraceEvent::TASK_DONE, threadId, 0);
+            //执行任务结束，空闲线程加1
+            _idleThreadSize++;
         }
-        //执行任务结束，空闲线程加1
-        _idleThreadSize++;
-        //更新线程空闲的起始时间戳
-        lasttime = std::chrono::high_resolution_clock().now();
     }
 }
 
-Result ThreadPool::submit(std::shared_ptr<Task> taskPtr) {
-    std::unique_lock<std::mutex> lock(_mtxPool);
-    /*
-    //只有满足任务队列不满条件才能继续向下执行，否则就进行阻塞
-    //如果阻塞，说明此时任务队列已经满了
-    //如果阻塞了1s后仍旧在阻塞，说明此时任务任务繁忙，没有多余的线程执行任务，就爆出错误
-    */
-    if (!_notFull.wait_for(lock, std::chrono::seconds(1),
-        [&]()->bool {return _taskQ.size() < _maxTaskSize; }))
-    {
-        std::cerr << "the task queue is Full! submit task fail!" << std::endl;
-        // return std::move(Result(taskPtr,false));
-        return Result(taskPtr, false);
-    }
-    _taskQ.emplace(taskPtr);
-    _curTaskSize++;
-    _notEmpty.notify_all();
+bool ThreadPool::Parker::park()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    cond.wait(lock, [this]() { return notified; });
+    notified = false;
+    return std::exchange(reserve, false);
+}
+
+void ThreadPool::Parker::unpark(bool toReserve)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    notified = true;
+    reserve = toReserve;
+    cond.notify_one();
+}
+
+void ThreadPool::pushIdle(Parker* parker)
+{
+    std::lock_guard<std::mutex> lock(_mtxIdle);
+    _idleStack.push_back(parker);
+    _waitingThreads++;
+}
 
-    //在线程模式处于cache模式下，如果当前任务小而重要，就需要对线程池进行扩容
-    if (_poolMode == PoolMode::MODE_CACHED
-        && _idleThreadSize < _curTaskSize
-        && _curThreadSize < _maxThreadSize)
+bool ThreadPool::removeIdle(Parker* parker)
+{
+    std::lock_guard<std::mutex> lock(_mtxIdle);
+    //刚压入栈的线程一般还在栈顶，从后往前找
+    for (auto it = _idleStack.rbegin(); it != _idleStack.rend(); ++it)
     {
-        //创建新线程
-        auto threadPtr = std::make_unique<Thread>(std::bind(&ThreadPool::threadWork, this, std::placeholders::_1));
-        int threadId = threadPtr->getThreadId();
+        if (*it == parker)
+        {
+            _idleStack.erase(std::next(it).base());
+            _waitingThreads--;
+            return true;
+        }
+    }
+    return false;
+}
 
-        std::cout << ">>>>>create new thread " << threadId << " [" << std::this_thread::get_id() << "]"<< std::endl;
+void ThreadPool::wakeOne()
+{
+    Parker* parker = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mtxIdle);
+        if (_idleStack.empty())
+            return;
+        parker = _idleStack.back();
+        _idleStack.pop_back();
+        _waitingThreads--;
+    }
+    //在空闲栈的锁外唤醒，被唤醒的线程不会和提交者争抢这把锁
+    parker->unpark();
+}
 
-        _pool.emplace(threadId, std::move(threadPtr));
-        _pool[threadId]->start();
-        _curThreadSize++;
-        _idleThreadSize++;
+void ThreadPool::wakeAll()
+{
+    std::vector<Parker*> parkers;
+    {
+        std::lock_guard<std::mutex> lock(_mtxIdle);
+        parkers.swap(_idleStack);
+        _waitingThreads -= static_cast<int>(parkers.size());
+        parkers.insert(parkers.end(), _reserveStack.begin(), _reserveStack.end());
+        _parkedThreads -= static_cast<int>(_reserveStack.size());
+        _reserveStack.clear();
+    }
+    for (Parker* parker : parkers)
+        parker->unpark();
+}
+
+void ThreadPool::parkReserve(Parker* parker)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mtxIdle);
+        //wakeAll也在这把锁内清空停放栈，关闭后不能再停放，否则没有人会唤醒它
+        if (!_isRunning)
+            return;
+        _reserveStack.push_back(parker);
+        _parkedThreads++;
+    }
+    parker->park();
+}
+
+void ThreadPool::growThreads(int count)
+{
+    //先唤醒停放的线程，它们的栈和线程局部数据都还在，不需要创建线程
+    std::vector<Parker*> parkers;
+    {
+        std::lock_guard<std::mutex> lock(_mtxIdle);
+        while (count > 0 && !_reserveStack.empty())
+        {
+            parkers.push_back(_reserveStack.back());
+            _reserveStack.pop_back();
+            _parkedThreads--;
+            count--;
+        }
+    }
+    for (Parker* parker : parkers)
+        parker->unpark();
+    if (count == 0)
+        return;
+    std::lock_guard<std::mutex> lock(_mtxPool);
+    while (count-- > 0 && _curThreadSize < _maxThreadSize)
+        createThread();
+}
+
+void ThreadPool::shrinkThreads(int count)
+{
+    //停放空闲栈底部的线程，它们空闲得最久，缓存已经冷了；正在执行任务的线程不受影响
+    std::vector<Parker*> parkers;
+    {
+        std::lock_guard<std::mutex> lock(_mtxIdle);
+        count = std::min(count, static_cast<int>(_idleStack.size()));
+        parkers.assign(_idleStack.begin(), _idleStack.begin() + count);
+        _idleStack.erase(_idleStack.begin(), _idleStack.begin() + count);
+        _waitingThreads -= count;
+    }
+    for (Parker* parker : parkers)
+        parker->unpark(true);
+}
+
+void ThreadPool::createThread()
+{
+    auto threadPtr = std::make_unique<Thread>(std::bind(&ThreadPool::threadWork, this, std::placeholders::_1));
+    int threadId = threadPtr->getThreadId();
+    TP_TRACE(TraceEvent::THREAD_CREATE, -1, threadId);
+
+    _pool.emplace(threadId, std::move(threadPtr));
+    _pool[threadId]->start();
+    _curThreadSize++;
+    _idleThreadSize++;
+}
+
+ScalingSample ThreadPool::collectSample(int64_t elapsedNanos)
+{
+    uint64_t enqueued = 0;
+    uint64_t dequeued = 0;
+    for (auto& level : _levels)
+    {
+        enqueued += level.enqueued.load(std::memory_order_relaxed);
+        dequeued += level.dequeued.load(std::memory_order_relaxed);
+    }
+    double seconds = std::max<int64_t>(elapsedNanos, 1) / 1e9;
+
+    ScalingSample sample;
+    sample.parkedThreads = _parkedThreads;
+    sample.activeThreads = _curThreadSize - sample.parkedThreads;
+    sample.busyThreads = std::max(_curThreadSize - _idleThreadSize, 0);
+    sample.queuedTasks = std::max(_curTaskSize.load(), 0);
+    sample.utilization = sample.activeThreads > 0
+        ? static_cast<double>(sample.busyThreads) / sample.activeThreads : 0;
+    sample.arrivalRate = (enqueued - _lastEnqueued) / seconds;
+    sample.completionRate = (dequeued - _lastDequeued) / seconds;
+    int64_t count = _waitStats.count.exchange(0, std::memory_order_relaxed);
+    int64_t sum = _waitStats.sum.exchange(0, std::memory_order_relaxed);
+    sample.avgQueueWait = count > 0 ? sum / count : 0;
+    sample.maxQueueWait = _waitStats.max.exchange(0, std::memory_order_relaxed);
+    _lastEnqueued = enqueued;
+    _lastDequeued = dequeued;
+    return sample;
+}
+
+void ThreadPool::controllerWork()
+{
+    int64_t lastSample = AdaptiveSpin::nowNanos();
+    int64_t lastChange = lastSample;
+    int64_t cooldown = std::chrono::duration_cast<std::chrono::nanoseconds>(_scalingConfig.cooldown).count();
+    std::unique_lock<std::mutex> lock(_mtxCtrl);
+    while (!_condCtrl.wait_for(lock, _scalingConfig.interval, [this]() { return _ctrlStop; }))
+    {
+        lock.unlock();
+        int64_t now = AdaptiveSpin::nowNanos();
+        ScalingSample sample = collectSample(now - lastSample);
+        lastSample = now;
+
+        int target = _scalingPolicy->decide(sample, _scalingConfig);
+        target = std::max(target, _scalingConfig.minThreads);
+        target = std::min(target, _maxThreadSize);
+        if (target > sample.activeThreads)
+        {
+            growThreads(target - sample.activeThreads);
+            lastChange = now;
+        }
+        else if (target < sample.activeThreads && now - lastChange >= cooldown)
+        {
+            shrinkThreads(sample.activeThreads - target);
+            lastChange = now;
+        }
+        lock.lock();
+        _lastSample = sample;
     }
-    return Result(taskPtr);
 }
 
-Task::Task() :
-    _result(nullptr) {}
+bool ThreadPool::popTask(TaskPtr<Task>& taskPtr)
+{
+    //先检查低优先级队列是否已经被跳过足够多次，是则优先调度一次
+    for (int i = PRIORITY_LEVELS - 1; i > 0; i--)
+    {
+        PriorityLevel& level = _levels[i];
+        if (level.skipped.load(std::memory_order_relaxed) >= AGINGTHRESHOLD
+            && level.queue->pop(taskPtr))
+        {
+            level.skipped.store(0, std::memory_order_relaxed);
+            level.depth--;
+            level.dequeued++;
+            level.aged++;
+            return true;
+        }
+    }
+    //按优先级从高到低取任务
+    for (int i = 0; i < PRIORITY_LEVELS; i++)
+    {
+        PriorityLevel& level = _levels[i];
+        if (level.queue->pop(taskPtr))
+        {
+            level.skipped.store(0, std::memory_order_relaxed);
+            level.depth--;
+            level.dequeued++;
+            //比当前优先级低且有任务在排队的队列，记一次跳过
+            for (int j = i + 1; j < PRIORITY_LEVELS; j++)
+            {
+                if (_levels[j].depth.load(std::memory_order_relaxed) > 0)
+                    _levels[j].skipped.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+PriorityStats ThreadPool::getPriorityStats(TaskPriority priority)const
+{
+    const PriorityLevel& level = _levels[static_cast<int>(priority)];
+    return PriorityStats{ level.depth.load(), level.enqueued.load(),
+        level.dequeued.load(), level.aged.load() };
+}
+
+void ThreadPool::setWaitStrategy(const WaitStrategy& strategy)
+{
+    _idleSpin.setStrategy(strategy);
+}
+
+WaitStrategy ThreadPool::getWaitStrategy()const
+{
+    return _idleSpin.getStrategy();
+}
+
+void ThreadPool::setRejectPolicy(RejectPolicy policy, std::chrono::milliseconds timeout)
+{
+    _rejectTimeout.store(timeout.count(), std::memory_order_relaxed);
+    _rejectPolicy.store(policy, std::memory_order_relaxed);
+}
+
+RejectPolicy ThreadPool::getRejectPolicy()const
+{
+    return _rejectPolicy.load(std::memory_order_relaxed);
+}
+
+uint64_t ThreadPool::getRejectCount(RejectPolicy policy)const
+{
+    return _rejectCount[static_cast<int>(policy)].load(std::memory_order_relaxed);
+}
+
+uint64_t ThreadPool::getCancelCount()const
+{
+    return _cancelCount.load(std::memory_order_relaxed);
+}
+
+Result ThreadPool::submit(std::shared_ptr<Task> taskPtr, TaskPriority priority) {
+    return submit(adoptShared(taskPtr), priority);
+}
+
+Result ThreadPool::submit(TaskPtr<Task> taskPtr, TaskPriority priority) {
+    bool isValid = enqueue(taskPtr, priority, _rejectPolicy.load(std::memory_order_relaxed));
+    return Result(std::move(taskPtr), isValid);
+}
+
+Result ThreadPool::trySubmit(std::shared_ptr<Task> taskPtr, TaskPriority priority) {
+    return trySubmit(adoptShared(taskPtr), priority);
+}
+
+Result ThreadPool::trySubmit(TaskPtr<Task> taskPtr, TaskPriority priority) {
+    bool isValid = enqueue(taskPtr, priority, RejectPolicy::REJECT_ABORT);
+    return Result(std::move(taskPtr), isValid);
+}
+
+Result ThreadPool::submit(std::shared_ptr<Task> taskPtr, const CancellationToken& token, TaskPriority priority) {
+    return submit(adoptShared(taskPtr), token, priority);
+}
+
+Result ThreadPool::submit(TaskPtr<Task> taskPtr, const CancellationToken& token, TaskPriority priority) {
+    bool isValid = enqueue(taskPtr, priority, _rejectPolicy.load(std::memory_order_relaxed), token);
+    return Result(std::move(taskPtr), isValid);
+}
+
+Result ThreadPool::trySubmit(std::shared_ptr<Task> taskPtr, const CancellationToken& token, TaskPriority priority) {
+    return trySubmit(adoptShared(taskPtr), token, priority);
+}
+
+Result ThreadPool::trySubmit(TaskPtr<Task> taskPtr, const CancellationToken& token, TaskPriority priority) {
+    bool isValid = enqueue(taskPtr, priority, RejectPolicy::REJECT_ABORT, token);
+    return Result(std::move(taskPtr), isValid);
+}
+
+bool ThreadPool::dropIfCancelled(const TaskPtr<Task>& taskPtr)
+{
+    if (!taskPtr->_token.IsCancelled())
+        return false;
+    _cancelCount++;
+    TP_TRACE(TraceEvent::TASK_CANCEL, -1, 0);
+    taskPtr->cancel();
+    return true;
+}
+
+bool ThreadPool::waitNotFull(PriorityLevel& level, const TaskPtr<Task>& taskPtr)
+{
+    std::chrono::milliseconds timeout(_rejectTimeout.load(std::memory_order_relaxed));
+    if (timeout.count() <= 0)
+        return false;
+    std::unique_lock<std::mutex> lock(_mtxPool);
+    _waitingProducers++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool pushed = _notFull.wait_for(lock, timeout,
+        [&]()->bool {return level.queue->push(taskPtr); });
+    _waitingProducers--;
+    return pushed;
+}
+
+void ThreadPool::evictOldest(PriorityLevel& level)
+{
+    TaskPtr<Task> oldest;
+    //工作线程可能刚好取走了任务，这时队列已经有了空位，不需要挤出
+    if (!level.queue->pop(oldest))
+        return;
+    level.depth--;
+    _curTaskSize--;
+    _rejectCount[static_cast<int>(RejectPolicy::REJECT_DROP_OLDEST)]++;
+    TP_TRACE(TraceEvent::TASK_REJECT, -1, static_cast<int>(RejectPolicy::REJECT_DROP_OLDEST));
+    oldest->reject(RejectPolicy::REJECT_DROP_OLDEST);
+}
+
+bool ThreadPool::enqueue(const TaskPtr<Task>& taskPtr, TaskPriority priority, RejectPolicy policy,
+    const CancellationToken& token) {
+    PriorityLevel& level = _levels[static_cast<int>(priority)];
+    //通过shared_ptr重新提交的任务可能上一次被拒绝或取消过，也可能已经完成过
+    taskPtr->_rejected = false;
+    taskPtr->_cancelled = false;
+    taskPtr->_done.reset();
+    taskPtr->_token = token;
+    taskPtr->resetResult();
+    //提交时已经取消的任务不进入队列，它没有被拒绝，Result仍然有效
+    if (dropIfCancelled(taskPtr))
+        return true;
+    //入队前记录时间，工作线程出队时计算排队时延
+    if (_poolMode == PoolMode::MODE_CACHED)
+        taskPtr->_enqueueNanos = AdaptiveSpin::nowNanos();
+    //入队前先增加队列深度，保证出队时深度不会短暂地变为负数
+    level.depth++;
+    //快速路径：队列未满时直接无锁入队
+    if (!level.queue->push(taskPtr))
+    {
+        TP_TRACE(TraceEvent::QUEUE_FULL, -1, static_cast<int>(policy));
+        bool pushed = false;
+        if (policy == RejectPolicy::REJECT_DROP_OLDEST)
+        {
+            //腾出空位后可能又被其他提交者抢走，重复直到放入为止
+            while (!level.queue->push(taskPtr))
+                evictOldest(level);
+            pushed = true;
+        }
+        else if (policy == RejectPolicy::REJECT_BLOCK_TIMEOUT)
+        {
+            pushed = waitNotFull(level, taskPtr);
+        }
+        if (!pushed)
+        {
+            level.depth--;
+            _rejectCount[static_cast<int>(policy)]++;
+            TP_TRACE(TraceEvent::TASK_REJECT, -1, static_cast<int>(policy));
+            if (policy == RejectPolicy::REJECT_CALLER_RUNS)
+            {
+                //在提交者线程上执行，Result照常可以取到返回值
+                taskPtr->exec();
+                return true;
+            }
+            taskPtr->reject(policy);
+            return false;
+        }
+    }
+    level.enqueued++;
+    _curTaskSize++;
+
+    //只有存在睡眠的工作线程时才需要唤醒，每个任务最多唤醒一个
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_waitingThreads.load(std::memory_order_relaxed) > 0)
+        wakeOne();
+
+    return true;
+}
+
 void Task::exec()
 {
-    if(_result)
-        _result->setVal(this->run());
+    _any = this->run();
+    finish();
 }
 
-void Task::setResult(Result* result)
+void Task::resetResult()
 {
-    _result = result;
+    _any = Any();
 }
 
-Result::Result(std::shared_ptr<Task> task, bool isValid)
-    :_taskPtr(task), _isValid(isValid) 
+void Task::finish()
 {
-    //初始化task指针里的result指针成员，让其能够正常执行exec成员函数
-    _taskPtr->setResult(this);
+    //没有线程在等待结果时不需要系统调用
+    _done.complete();
 }
 
-Any Result::get()
+void Task::waitFinish()
 {
-    if (!_isValid)
-        return "";
-    //如果任务没有执行完，在这里进行阻塞，不将返回值进行返回
-    _sem.wait();
-    return std::move(_any);
+    _done.wait();
+}
+
+bool Task::finished()const
+{
+    return _done.isDone();
+}
+
+void Task::reject(RejectPolicy policy)
+{
+    _rejected = true;
+    _rejectPolicy = policy;
+    finish();
+}
+
+void Task::throwIfRejected()const
+{
+    if (_rejected)
+        throw TaskRejected(_rejectPolicy);
+}
+
+void Task::cancel()
+{
+    _cancelled = true;
+    finish();
+}
+
+void Task::throwIfCancelled()const
+{
+    if (_cancelled)
+        throw TaskCancelled();
+}
+
+static const char* rejectMessage(RejectPolicy policy)
+{
+    switch (policy)
+    {
+    case RejectPolicy::REJECT_ABORT: return "the task queue is full, task rejected";
+    case RejectPolicy::REJECT_CALLER_RUNS: return "the task ran on the caller thread";
+    case RejectPolicy::REJECT_DROP_OLDEST: return "the task was evicted by a newer task";
+    case RejectPolicy::REJECT_DROP_NEWEST: return "the task queue is full, task dropped";
+    case RejectPolicy::REJECT_BLOCK_TIMEOUT: return "timed out waiting for the task queue";
+    }
+    return "task rejected";
 }
-void Result::setVal(Any any)
+
+TaskRejected::TaskRejected(RejectPolicy policy)
+    :TaskError(rejectMessage(policy)), _policy(policy)
+{}
+
+Result::Result(TaskPtr<Task> task, bool isValid)
+    :_taskPtr(std::move(task)), _isValid(isValid)
+{}
+
+bool Result::isValid()const
 {
-    _any = std::move(any);
-    //成功获取任务的返回值，增加信号量资源
-    _sem.post();
+    return _isValid;
+}
+
+bool Result::ready()const
+{
+    return _taskPtr && _taskPtr->finished();
+}
+
+Any Result::get()
+{
+    //与TypedResult::get一致，结果已经取走（或者Result已经被移走）时抛出异常
+    if (!_taskPtr)
+        throw TaskError("the result has already been retrieved");
+    //取走结果后释放对任务的引用，工作线程也执行完毕时任务立即回收
+    TaskPtr<Task> task = std::move(_taskPtr);
+    //如果任务没有执行完，在这里进行阻塞，不将返回值进行返回
+    task->waitFinish();
+    task->throwIfRejected();
+    task->throwIfCancelled();
+    return std::move(task->_any);
 }
@@ -0,0 +1,178 @@
+#include "trace.h"
+#include<algorithm>
+
+namespace {
+//所有线程的缓冲区，只在注册和导出时加锁
+std::mutex g_registryMtx;
+std::vector<std::shared_ptr<TraceBuffer>> g_buffers;
+uint64_t g_dropped = 0;
+
+//后台导出线程
+std::mutex g_drainerMtx;
+std::condition_variable g_drainerCond;
+std::thread g_drainer;
+bool g_drainerStop = false;
+
+uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//线程退出时标记缓冲区，等导出后再从注册表中移除
+struct LocalBufferHolder {
+    std::shared_ptr<TraceBuffer> buffer;
+    ~LocalBufferHolder()
+    {
+        if (buffer)
+            buffer->retired.store(true, std::memory_order_release);
+    }
+};
+}
+
+std::atomic<bool> Tracer::_enabled(false);
+
+const char* traceEventName(TraceEvent event)
+{
+    switch (event)
+    {
+    case TraceEvent::THREAD_START: return "thread_start";
+    case TraceEvent::THREAD_EXIT: return "thread_exit";
+    case TraceEvent::THREAD_CREATE: return "thread_create";
+    case TraceEvent::TASK_WAIT: return "task_wait";
+    case TraceEvent::TASK_DEQUEUE: return "task_dequeue";
+    case TraceEvent::TASK_DONE: return "task_done";
+    case TraceEvent::QUEUE_FULL: return "queue_full";
+    case TraceEvent::POOL_EXIT: return "pool_exit";
+    case TraceEvent::TASK_REJECT: return "task_reject";
+    case TraceEvent::TASK_CANCEL: return "task_cancel";
+    }
+    return "unknown";
+}
+
+TraceBuffer::TraceBuffer()
+    :retired(false),
+    _records(new TraceRecord[CAPACITY]),
+    _head(0),
+    _tail(0),
+    _dropped(0)
+{}
+
+void TraceBuffer::drain(std::vector<TraceRecord>& out)
+{
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    uint64_t head = _head.load(std::memory_order_acquire);
+    for (; tail != head; tail++)
+        out.push_back(_records[tail & (CAPACITY - 1)]);
+    _tail.store(tail, std::memory_order_release);
+}
+
+uint64_t TraceBuffer::dropped()const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+bool TraceBuffer::empty()const
+{
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed);
+}
+
+void Tracer::enable(bool on)
+{
+    _enabled.store(on, std::memory_order_relaxed);
+}
+
+std::shared_ptr<TraceBuffer> Tracer::localBuffer()
+{
+    thread_local LocalBufferHolder holder;
+    if (!holder.buffer)
+    {
+        holder.buffer = std::make_shared<TraceBuffer>();
+        std::lock_guard<std::mutex> lock(g_registryMtx);
+        g_buffers.push_back(holder.buffer);
+    }
+    return holder.buffer;
+}
+
+void Tracer::record(TraceEvent event, int threadId, uint64_t arg)
+{
+    thread_local TraceBuffer* buffer = localBuffer().get();
+    TraceRecord record;
+    record.timestamp = nowNanos();
+    record.threadId = threadId;
+    record.event = event;
+    record.reserved = 0;
+    record.arg = arg;
+    buffer->push(record);
+}
+
+size_t Tracer::dump(std::ostream& os)
+{
+    std::vector<TraceRecord> records;
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_registryMtx);
+        for (auto& buffer : g_buffers)
+        {
+            buffer->drain(records);
+            dropped += buffer->dropped();
+        }
+        //回收已退出线程的空缓冲区，丢弃计数累加到全局
+        for (auto it = g_buffers.begin(); it != g_buffers.end();)
+        {
+            if ((*it)->retired.load(std::memory_order_acquire) && (*it)->empty())
+            {
+                g_dropped += (*it)->dropped();
+                it = g_buffers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        dropped += g_dropped;
+    }
+
+    std::sort(records.begin(), records.end(),
+        [](const TraceRecord& a, const TraceRecord& b) { return a.timestamp < b.timestamp; });
+    for (const auto& r : records)
+    {
+        os << r.timestamp / 1000 << "us thread=" << r.threadId
+            << " " << traceEventName(r.event) << " arg=" << r.arg << "\n";
+    }
+    if (dropped > 0)
+        os << "trace dropped " << dropped << " events\n";
+    os.flush();
+    return records.size();
+}
+
+void Tracer::startDrainer(std::ostream& os, std::chrono::milliseconds interval)
+{
+    stopDrainer();
+    std::lock_guard<std::mutex> lock(g_drainerMtx);
+    g_drainerStop = false;
+    std::ostream* out = &os;
+    g_drainer = std::thread([out, interval]() {
+        std::unique_lock<std::mutex> lock(g_drainerMtx);
+        while (!g_drainerStop)
+        {
+            g_drainerCond.wait_for(lock, interval, []() { return g_drainerStop; });
+            lock.unlock();
+            dump(*out);
+            lock.lock();
+        }
+    });
+}
+
+void Tracer::stopDrainer()
+{
+    std::thread drainer;
+    {
+        std::lock_guard<std::mutex> lock(g_drainerMtx);
+        g_drainerStop = true;
+        drainer = std::move(g_drainer);
+    }
+    g_drainerCond.notify_all();
+    if (drainer.joinable())
+        drainer.join();
+}
@@ -0,0 +1,69 @@
+#include "wait_strategy.h"
+#include <algorithm>
+
+//单个样本的上限，避免一次很长的空闲让平滑值很久都降不下来
+const int64_t MAXWAITSAMPLE = 10 * 1000 * 1000;
+//平滑系数为1/8
+const int WAITSMOOTHSHIFT = 3;
+
+void AdaptiveSpin::setStrategy(const WaitStrategy& strategy)
+{
+    _mode.store(static_cast<int>(strategy.mode), std::memory_order_relaxed);
+    _spinNanos.store(std::max(0, strategy.spinMicros) * int64_t(1000), std::memory_order_relaxed);
+    _yieldNanos.store(std::max(0, strategy.yieldMicros) * int64_t(1000), std::memory_order_relaxed);
+    //从预算的一半开始，第一次等待就能用满整个预算
+    _avgWait.store((_spinNanos.load(std::memory_order_relaxed)
+        + _yieldNanos.load(std::memory_order_relaxed)) / 2, std::memory_order_relaxed);
+}
+
+WaitStrategy AdaptiveSpin::getStrategy()const
+{
+    WaitStrategy strategy;
+    strategy.mode = static_cast<WaitMode>(_mode.load(std::memory_order_relaxed));
+    strategy.spinMicros = static_cast<int>(_spinNanos.load(std::memory_order_relaxed) / 1000);
+    strategy.yieldMicros = static_cast<int>(_yieldNanos.load(std::memory_order_relaxed) / 1000);
+    return strategy;
+}
+
+void AdaptiveSpin::recordWait(int64_t nanos)
+{
+    nanos = std::min(std::max<int64_t>(nanos, 0), MAXWAITSAMPLE);
+    int64_t avg = _avgWait.load(std::memory_order_relaxed);
+    _avgWait.store(avg + ((nanos - avg) >> WAITSMOOTHSHIFT), std::memory_order_relaxed);
+}
+
+int64_t AdaptiveSpin::averageWait()const
+{
+    return _avgWait.load(std::memory_order_relaxed);
+}
+
+void AdaptiveSpin::budget(int64_t& spinNanos, int64_t& yieldNanos)const
+{
+    WaitMode mode = static_cast<WaitMode>(_mode.load(std::memory_order_relaxed));
+    spinNanos = 0;
+    yieldNanos = 0;
+    if (mode == WaitMode::WAIT_BLOCK)
+        return;
+    spinNanos = _spinNanos.load(std::memory_order_relaxed);
+    yieldNanos = _yieldNanos.load(std::memory_order_relaxed);
+    //只有一个CPU时，自旋期间要等的那个线程根本得不到运行，只保留让出CPU的阶段
+    static const bool singleCpu = std::thread::hardware_concurrency() <= 1;
+    if (singleCpu)
+        spinNanos = 0;
+    if (mode == WaitMode::WAIT_SPIN)
+        return;
+    /*
+    平均等待超过自旋加让出CPU总预算的数倍，多半要睡眠，直接跳过自旋
+    否则自旋到平均等待时间的两倍，最多到配置的上限
+    */
+    int64_t avg = _avgWait.load(std::memory_order_relaxed);
+    if (avg > 4 * (spinNanos + yieldNanos))
+    {
+        spinNanos = 0;
+        yieldNanos = 0;
+        return;
+    }
+    int64_t target = std::max<int64_t>(2 * avg, 1000);
+    spinNanos = std::min(spinNanos, target);
+    yieldNanos = std::min(yieldNanos, std::max<int64_t>(target - spinNanos, 0));
+}
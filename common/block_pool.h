@@ -0,0 +1,118 @@
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+// 固定大小内存块的缓存池
+// 每个线程维护自己的空闲链表，分配和释放一般不需要加锁；
+// 任务常常在提交线程分配、在工作线程或等待结果的线程释放，本地链表过长时成批归还到全局链表，
+// 本地链表为空时再从全局链表成批取回，加锁的开销被一批内存块分摊
+template <size_t BlockSize>
+class BlockPool {
+public:
+    static void* Allocate() {
+        FreeList& list = Local();
+        if (Dead())
+            return ::operator new(BlockSize);
+        if (list.head == nullptr)
+            Refill(list);
+        if (list.head != nullptr) {
+            Node* node = list.head;
+            list.head = node->next;
+            --list.count;
+            return node;
+        }
+        return ::operator new(BlockSize);
+    }
+
+    static void Deallocate(void* ptr) {
+        FreeList& list = Local();
+        if (Dead()) {
+            ::operator delete(ptr);
+            return;
+        }
+        Node* node = static_cast<Node*>(ptr);
+        node->next = list.head;
+        list.head = node;
+        ++list.count;
+        if (list.count >= 2 * kBatch)
+            Flush(list);
+    }
+
+private:
+    static constexpr size_t kBatch = 64;
+    // 全局链表最多缓存的内存块数，超出部分归还给系统
+    static constexpr size_t kMaxShared = 64 * 1024;
+
+    struct Node {
+        Node* next;
+    };
+
+    struct FreeList {
+        Node* head = nullptr;
+        size_t count = 0;
+        ~FreeList() {
+            while (head != nullptr) {
+                Node* next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+            Dead() = true;
+        }
+    };
+
+    struct SharedList {
+        std::mutex mtx;
+        Node* head = nullptr;
+        size_t count = 0;
+    };
+
+    static FreeList& Local() {
+        static thread_local FreeList list;
+        return list;
+    }
+    // 线程退出时链表已析构，之后的释放直接归还给系统
+    static bool& Dead() {
+        static thread_local bool dead = false;
+        return dead;
+    }
+    // 全局链表不析构，避免进程退出时其他线程仍在访问
+    static SharedList& Shared() {
+        static SharedList* shared = new SharedList();
+        return *shared;
+    }
+
+    static void Refill(FreeList& list) {
+        SharedList& shared = Shared();
+        std::lock_guard<std::mutex> lock(shared.mtx);
+        while (shared.head != nullptr && list.count < kBatch) {
+            Node* node = shared.head;
+            shared.head = node->next;
+            --shared.count;
+            node->next = list.head;
+            list.head = node;
+            ++list.count;
+        }
+    }
+
+    static void Flush(FreeList& list) {
+        SharedList& shared = Shared();
+        std::lock_guard<std::mutex> lock(shared.mtx);
+        while (list.count > kBatch) {
+            Node* node = list.head;
+            list.head = node->next;
+            --list.count;
+            if (shared.count >= kMaxShared) {
+                ::operator delete(node);
+                continue;
+            }
+            node->next = shared.head;
+            shared.head = node;
+            ++shared.count;
+        }
+    }
+};
+
+#endif // BLOCK_POOL_H
@@ -0,0 +1,144 @@
+#ifndef __CANCELLATION__
+#define __CANCELLATION__
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "inline_task.h"
+
+// 任务在执行前被取消时，future 中保存的异常
+class TaskCancelled : public std::runtime_error {
+public:
+    TaskCancelled() : std::runtime_error("task cancelled") {}
+};
+
+namespace detail {
+
+// 一个 CancellationSource 的共享状态，子节点以弱引用挂在父节点上
+struct CancelState {
+    std::atomic<bool> cancelled{false};
+    std::mutex mtx;
+    std::vector<std::weak_ptr<CancelState>> children;
+    size_t prune_at = 8;  // 子节点列表达到该长度时清理已经析构的子节点
+
+    void AddChild(const std::shared_ptr<CancelState>& child) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!cancelled.load(std::memory_order_relaxed)) {
+                if (children.size() >= prune_at) {
+                    children.erase(std::remove_if(children.begin(), children.end(),
+                                                  [](const std::weak_ptr<CancelState>& c) {
+                                                      return c.expired();
+                                                  }),
+                                   children.end());
+                    prune_at = std::max<size_t>(8, children.size() * 2);
+                }
+                children.push_back(child);
+                return;
+            }
+        }
+        // 父节点已经取消，子节点创建出来就是取消状态
+        Cancel(child);
+    }
+
+    // 取消 root 以及它的所有后代，用显式的栈代替递归，层次很深时也不会栈溢出
+    static void Cancel(const std::shared_ptr<CancelState>& root) {
+        std::vector<std::shared_ptr<CancelState>> pending{root};
+        while (!pending.empty()) {
+            std::shared_ptr<CancelState> state = std::move(pending.back());
+            pending.pop_back();
+            std::vector<std::weak_ptr<CancelState>> children;
+            {
+                std::lock_guard<std::mutex> lock(state->mtx);
+                if (state->cancelled.exchange(true, std::memory_order_release)) continue;
+                children.swap(state->children);
+            }
+            for (auto& weak : children) {
+                if (auto child = weak.lock()) pending.push_back(std::move(child));
+            }
+        }
+    }
+};
+
+}  // namespace detail
+
+// 只读的取消标记，由 CancellationSource 产生，可以随意复制并传给任务
+// 默认构造的 token 永远不会被取消
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    // 只有一次 relaxed 原子读取，执行中的任务可以在循环里频繁检查
+    bool IsCancelled() const {
+        return state_ && state_->cancelled.load(std::memory_order_relaxed);
+    }
+
+    bool CanBeCancelled() const { return state_ != nullptr; }
+
+    void ThrowIfCancelled() const {
+        if (IsCancelled()) throw TaskCancelled();
+    }
+
+private:
+    friend class CancellationSource;
+    explicit CancellationToken(std::shared_ptr<detail::CancelState> state)
+        : state_(std::move(state)) {}
+
+    std::shared_ptr<detail::CancelState> state_;
+};
+
+// 取消的发起方。以父 token 构造时成为它的子节点，父节点取消时一并取消
+// 例如一次请求一个根 source，请求派生出的子任务各自持有子 source，请求超时时取消整棵树
+class CancellationSource {
+public:
+    CancellationSource() : state_(std::make_shared<detail::CancelState>()) {}
+
+    explicit CancellationSource(const CancellationToken& parent) : CancellationSource() {
+        if (parent.state_) parent.state_->AddChild(state_);
+    }
+
+    CancellationToken Token() const { return CancellationToken(state_); }
+
+    void Cancel() { detail::CancelState::Cancel(state_); }
+
+    bool IsCancelled() const { return state_->cancelled.load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<detail::CancelState> state_;
+};
+
+// 与 MakePromiseTask 相同，但出队时 token 已经取消则不再调用 f，
+// promise 直接得到 TaskCancelled 异常
+template <typename R, typename F, typename... Args>
+InlineTask MakeCancellableTask(CancellationToken token, std::promise<R> promise, F&& f,
+                               Args&&... args) {
+    return InlineTask(
+        [token = std::move(token), promise = std::move(promise), func = std::forward<F>(f),
+         bound = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+            if (token.IsCancelled()) {
+                promise.set_exception(std::make_exception_ptr(TaskCancelled()));
+                return;
+            }
+            try {
+                if constexpr (std::is_void<R>::value) {
+                    std::apply(func, bound);
+                    promise.set_value();
+                } else {
+                    promise.set_value(std::apply(func, bound));
+                }
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        });
+}
+
+#endif
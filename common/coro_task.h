@@ -0,0 +1,263 @@
+#ifndef CORO_TASK_H
+#define CORO_TASK_H
+
+// 线程池的 C++20 协程支持，使用 C++17 编译时整个头文件为空
+//   co_await pool.Schedule();            切换到线程池的工作线程上继续执行
+//   co_await coro::Async(pool, f);       在工作线程上执行 f，完成后在该线程上恢复
+//   coro::Task<T>                        惰性协程，被 co_await 时才开始执行
+//   coro::SyncWait(task) / coro::Spawn   在普通函数中等待协程 / 启动后不等待
+// 协程在等待期间不占用线程，大量逻辑上的并发操作可以共享少量工作线程
+// 线程池需要提供 void Post(F&&)
+#if __cplusplus >= 202002L
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace coro {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+template <typename T>
+using Storage = typename std::conditional<std::is_void<T>::value, char, T>::type;
+
+struct TaskPromiseBase {
+    // 结束时恢复等待者，使用对称转移避免嵌套调用栈
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().continuation;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    Task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U&& value) {
+        result.emplace(std::forward<U>(value));
+    }
+
+    T Result() {
+        if (error)
+            std::rethrow_exception(error);
+        return std::move(*result);
+    }
+
+    std::optional<T> result;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void Result() {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+// 启动后不被等待的协程，执行完毕后自行销毁
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+} // namespace detail
+
+// 惰性协程：创建后不执行，被 co_await 时才开始，结束后恢复等待者
+// 协程中抛出的异常在 co_await 处重新抛出
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_)
+                handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept { return handle.done(); }
+            std::coroutine_handle<>
+            await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().Result(); }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    friend struct detail::TaskPromise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+        : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(
+        std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+template <typename T>
+struct SyncWaitState {
+    std::mutex mtx;
+    std::condition_variable cond;
+    bool done = false;
+    std::optional<Storage<T>> result;
+    std::exception_ptr error;
+};
+
+template <typename T>
+Detached SyncWaitImpl(Task<T> task, SyncWaitState<T>* state) {
+    try {
+        if constexpr (std::is_void<T>::value) {
+            co_await std::move(task);
+        } else {
+            state->result.emplace(co_await std::move(task));
+        }
+    } catch (...) {
+        state->error = std::current_exception();
+    }
+    // 在锁内通知，等待者返回时协程已经不再访问 state
+    std::lock_guard<std::mutex> lock(state->mtx);
+    state->done = true;
+    state->cond.notify_all();
+}
+
+inline Detached SpawnImpl(Task<void> task) { co_await std::move(task); }
+
+} // namespace detail
+
+// 在普通函数中阻塞等待协程执行完毕，返回结果或重新抛出异常
+template <typename T>
+T SyncWait(Task<T> task) {
+    detail::SyncWaitState<T> state;
+    detail::SyncWaitImpl(std::move(task), &state);
+    std::unique_lock<std::mutex> lock(state.mtx);
+    state.cond.wait(lock, [&state]() { return state.done; });
+    if (state.error)
+        std::rethrow_exception(state.error);
+    if constexpr (!std::is_void<T>::value)
+        return std::move(*state.result);
+}
+
+// 启动协程后立即返回，协程在第一次挂起的位置交出当前线程
+// 与 std::thread 一样，协程中未捕获的异常会调用 std::terminate
+inline void Spawn(Task<void> task) { detail::SpawnImpl(std::move(task)); }
+
+// co_await pool.Schedule() 的等待体：把协程的恢复投递到线程池
+template <typename Pool>
+class ScheduleAwaitable {
+public:
+    explicit ScheduleAwaitable(Pool& pool) : pool_(pool) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        pool_.Post([handle]() { handle.resume(); });
+    }
+    void await_resume() const noexcept {}
+
+private:
+    Pool& pool_;
+};
+
+// 在工作线程上执行 fn，协程在等待期间挂起，fn 完成后在同一个工作线程上恢复
+template <typename Pool, typename F>
+class AsyncAwaitable {
+public:
+    using result_type = typename std::invoke_result<F&>::type;
+
+    AsyncAwaitable(Pool& pool, F fn) : pool_(pool), fn_(std::move(fn)) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        pool_.Post([this, handle]() {
+            try {
+                if constexpr (std::is_void<result_type>::value)
+                    fn_();
+                else
+                    result_.emplace(fn_());
+            } catch (...) {
+                error_ = std::current_exception();
+            }
+            handle.resume();
+        });
+    }
+    result_type await_resume() {
+        if (error_)
+            std::rethrow_exception(error_);
+        if constexpr (!std::is_void<result_type>::value)
+            return std::move(*result_);
+    }
+
+private:
+    Pool& pool_;
+    F fn_;
+    std::optional<detail::Storage<result_type>> result_;
+    std::exception_ptr error_;
+};
+
+template <typename Pool, typename F>
+AsyncAwaitable<Pool, typename std::decay<F>::type> Async(Pool& pool, F&& fn) {
+    return AsyncAwaitable<Pool, typename std::decay<F>::type>(
+        pool, std::forward<F>(fn));
+}
+
+} // namespace coro
+
+#endif // __cplusplus >= 202002L
+
+#endif // CORO_TASK_H
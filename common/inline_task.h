@@ -0,0 +1,219 @@
+#ifndef INLINE_TASK_H
+#define INLINE_TASK_H
+
+#include <cstddef>
+#include <future>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "block_pool.h"
+
+// 从 BlockPool 分配单个对象的分配器，用于 promise 的共享状态等
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n == 1 && alignof(T) <= alignof(std::max_align_t))
+            return static_cast<T*>(BlockPool<BlockSizeOf()>::Allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        if (n == 1 && alignof(T) <= alignof(std::max_align_t))
+            BlockPool<BlockSizeOf()>::Deallocate(ptr);
+        else
+            ::operator delete(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const noexcept {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const noexcept {
+        return false;
+    }
+
+private:
+    // 按16字节对齐归类，减少不同类型各自占用一个池
+    static constexpr size_t BlockSizeOf() {
+        return (sizeof(T) + 15) / 16 * 16;
+    }
+};
+
+// 只能移动的任务类型，可调用对象不超过 kInlineSize 时直接存放在对象内部，
+// 超出时才从 BlockPool 中分配
+class InlineTask {
+public:
+    // 留出 std::promise 的空间，用户约64字节以内的闭包都不需要额外分配
+    static constexpr size_t kInlineSize = 96;
+
+    InlineTask() noexcept = default;
+
+    template <typename F,
+              typename = typename std::enable_if<!std::is_same<
+                  typename std::decay<F>::type, InlineTask>::value>::type>
+    InlineTask(F&& f) {
+        using Fn = typename std::decay<F>::type;
+        if constexpr (sizeof(Fn) <= kInlineSize &&
+                      alignof(Fn) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible<Fn>::value) {
+            ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(f));
+            ops_ = &InlineOps<Fn>::ops;
+        } else {
+            Fn* ptr = PoolAllocator<Fn>().allocate(1);
+            ::new (static_cast<void*>(ptr)) Fn(std::forward<F>(f));
+            ::new (static_cast<void*>(storage_)) Fn*(ptr);
+            ops_ = &HeapOps<Fn>::ops;
+        }
+    }
+
+    InlineTask(InlineTask&& other) noexcept : ops_(other.ops_) {
+        if (ops_ != nullptr) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InlineTask& operator=(InlineTask&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            ops_ = other.ops_;
+            if (ops_ != nullptr) {
+                ops_->move(storage_, other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    ~InlineTask() { Reset(); }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    void operator()() { ops_->invoke(storage_); }
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void*);
+    };
+
+    template <typename Fn>
+    struct InlineOps {
+        static void Invoke(void* p) { (*static_cast<Fn*>(p))(); }
+        static void Move(void* dst, void* src) {
+            ::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        }
+        static void Destroy(void* p) { static_cast<Fn*>(p)->~Fn(); }
+        static constexpr Ops ops = {&Invoke, &Move, &Destroy};
+    };
+
+    template <typename Fn>
+    struct HeapOps {
+        static Fn*& Ptr(void* p) { return *static_cast<Fn**>(p); }
+        static void Invoke(void* p) { (*Ptr(p))(); }
+        static void Move(void* dst, void* src) { ::new (dst) Fn*(Ptr(src)); }
+        static void Destroy(void* p) {
+            Fn* ptr = Ptr(p);
+            ptr->~Fn();
+            PoolAllocator<Fn>().deallocate(ptr, 1);
+        }
+        static constexpr Ops ops = {&Invoke, &Move, &Destroy};
+    };
+
+    void Reset() {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops* ops_ = nullptr;
+};
+
+// 把可调用对象和参数打包成写入 promise 的任务，
+// 参数按值保存并以左值传入，与 std::bind 的行为一致
+template <typename R, typename F, typename... Args>
+InlineTask MakePromiseTask(std::promise<R> promise, F&& f, Args&&... args) {
+    return InlineTask(
+        [promise = std::move(promise), func = std::forward<F>(f),
+         bound = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+            try {
+                if constexpr (std::is_void<R>::value) {
+                    std::apply(func, bound);
+                    promise.set_value();
+                } else {
+                    promise.set_value(std::apply(func, bound));
+                }
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        });
+}
+
+// 任务使用的 promise，共享状态和结果存储都从 BlockPool 中分配
+template <typename R>
+std::promise<R> MakePooledPromise() {
+    return std::promise<R>(std::allocator_arg, PoolAllocator<char>());
+}
+
+// 基于环形数组的队列，容量不足时按2倍扩容，稳定后入队出队不再分配内存
+template <typename T>
+class RingQueue {
+public:
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    void push(T&& item) {
+        if (size_ == buffer_.size())
+            Grow();
+        buffer_[(head_ + size_) & (buffer_.size() - 1)] = std::move(item);
+        ++size_;
+    }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        push(T(std::forward<Args>(args)...));
+    }
+
+    T& front() { return buffer_[head_]; }
+
+    void pop() {
+        buffer_[head_] = T();
+        head_ = (head_ + 1) & (buffer_.size() - 1);
+        --size_;
+    }
+
+private:
+    void Grow() {
+        std::vector<T> bigger(buffer_.empty() ? 16 : buffer_.size() * 2);
+        for (size_t i = 0; i < size_; ++i)
+            bigger[i] = std::move(buffer_[(head_ + i) & (buffer_.size() - 1)]);
+        buffer_.swap(bigger);
+        head_ = 0;
+    }
+
+    std::vector<T> buffer_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+using TaskQueue = RingQueue<InlineTask>;
+
+#endif // INLINE_TASK_H
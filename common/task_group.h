@@ -0,0 +1,94 @@
+#ifndef TASK_GROUP_H
+#define TASK_GROUP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace detail {
+
+// 一个 TaskGroup 的共享状态，线程池中排队的任务也持有它，组析构后仍然有效
+struct TaskGroupState {
+    std::atomic<int> unfinished{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;  // 由把 failed 置为 true 的任务写入，计数归零之后读取
+    // 只在计数归零和等待者睡眠时使用
+    std::mutex mtx;
+    std::condition_variable done;
+
+    void Finish() {
+        if (unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mtx);
+            done.notify_all();
+        }
+    }
+};
+
+}  // namespace detail
+
+// 一组 fork-join 任务：Run 提交，Wait 等待全部完成
+// 整组只有一个未完成计数和一个条件变量，不为每个任务创建 future，Run 不加锁；
+// 任务直接放进线程池的队列，在工作线程中 Wait 时通过 TryRunPending 帮忙执行排队的任务，
+// 因此在工作线程里嵌套使用也不会因为等待占住线程而死锁。没有可执行的任务时在条件变量上睡眠
+// 第一个异常在 Wait 中重新抛出，之后尚未开始的任务被跳过
+// Pool 需要提供 Post(f) 和 TryRunPending()，两个线程池都可以使用：TaskGroup group(pool);
+template<typename Pool>
+class TaskGroup {
+public:
+    explicit TaskGroup(Pool& pool)
+        : pool_(pool), state_(std::make_shared<detail::TaskGroupState>()) {}
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // 析构前必须等所有任务结束，它们可能引用调用者栈上的数据；异常在这里被丢弃
+    ~TaskGroup() { Drain(); }
+
+    template<typename F>
+    void Run(F&& f) {
+        state_->unfinished.fetch_add(1, std::memory_order_relaxed);
+        pool_.Post([state = state_, fn = std::forward<F>(f)]() mutable {
+            if (!state->failed.load(std::memory_order_relaxed)) {
+                // 闭包在计数减少之前析构，Wait 返回后不会再访问调用者的数据
+                auto task = std::move(fn);
+                try {
+                    task();
+                } catch (...) {
+                    if (!state->failed.exchange(true, std::memory_order_relaxed)) {
+                        state->error = std::current_exception();
+                    }
+                }
+            }
+            state->Finish();
+        });
+    }
+
+    // 等待组内所有任务完成，工作线程上等待时先帮忙执行排队的任务
+    // Wait 返回后可以继续 Run，同一个组可以重复使用
+    void Wait() {
+        Drain();
+        std::exception_ptr error = std::move(state_->error);
+        state_->error = nullptr;
+        state_->failed.store(false, std::memory_order_relaxed);
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    void Drain() {
+        while (state_->unfinished.load(std::memory_order_acquire) != 0) {
+            if (pool_.TryRunPending()) continue;
+            // 队列已经空了，剩下的任务正在其他线程上执行
+            std::unique_lock<std::mutex> lock(state_->mtx);
+            state_->done.wait(lock, [this]() {
+                return state_->unfinished.load(std::memory_order_acquire) == 0;
+            });
+        }
+    }
+
+    Pool& pool_;
+    std::shared_ptr<detail::TaskGroupState> state_;
+};
+
+#endif // TASK_GROUP_H
@@ -0,0 +1,75 @@
+// 协程支持的测试，需要使用 C++20 编译
+#include "threadPool.h"
+#include <gtest/gtest.h>
+
+class CoroutineTest : public ::testing::TestWithParam<ScheduleMode> {
+ public:
+    void SetUp() override { pool_ = std::make_unique<ThreadPool>(2, GetParam()); }
+    void TearDown() override { pool_->ShutDown(); }
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+coro::Task<std::thread::id> ResumeOnWorker(ThreadPool &pool) {
+    co_await pool.Schedule();
+    co_return std::this_thread::get_id();
+}
+
+TEST_P(CoroutineTest, ScheduleResumesOnWorker) {
+    auto id = coro::SyncWait(ResumeOnWorker(*pool_));
+    EXPECT_NE(id, std::this_thread::get_id());
+}
+
+coro::Task<long long> SumRange(ThreadPool &pool, int begin, int end) {
+    // 区间较大时拆成两半，两个子协程在工作线程上执行
+    if (end - begin <= 1000) {
+        long long sum = co_await coro::Async(pool, [begin, end]() {
+            long long s = 0;
+            for (int i = begin; i < end; ++i)
+                s += i;
+            return s;
+        });
+        co_return sum;
+    }
+    int mid = begin + (end - begin) / 2;
+    long long left = co_await SumRange(pool, begin, mid);
+    long long right = co_await SumRange(pool, mid, end);
+    co_return left + right;
+}
+
+TEST_P(CoroutineTest, AsyncAndNestedTasks) {
+    EXPECT_EQ(coro::SyncWait(SumRange(*pool_, 0, 100000)), 4999950000LL);
+}
+
+coro::Task<void> Throwing(ThreadPool &pool) {
+    co_await coro::Async(pool, []() { throw std::runtime_error("boom"); });
+}
+
+TEST_P(CoroutineTest, ExceptionPropagates) {
+    EXPECT_THROW(coro::SyncWait(Throwing(*pool_)), std::runtime_error);
+}
+
+// 几千个协程交替挂起和恢复，只使用两个工作线程
+coro::Task<void> Hopper(ThreadPool &pool, std::atomic<int> &done) {
+    for (int i = 0; i < 10; ++i)
+        co_await pool.Schedule();
+    done++;
+}
+
+TEST_P(CoroutineTest, ThousandsInFlight) {
+    const int kCount = 5000;
+    std::atomic<int> done(0);
+    for (int i = 0; i < kCount; ++i)
+        coro::Spawn(Hopper(*pool_, done));
+    while (done.load() < kCount)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(done.load(), kCount);
+}
+
+INSTANTIATE_TEST_SUITE_P(Modes, CoroutineTest,
+                         ::testing::Values(ScheduleMode::kGlobalQueue,
+                                           ScheduleMode::kWorkStealing));
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,4 +1,6 @@
+#include "task_group.h"
 #include "threadPool.h"
+#include <array>
 #include <gtest/gtest.h>
 
 #if 1
@@ -74,6 +76,192 @@ TEST_F(ThreadPoolTest, TestThreadPoolSubmit) {
     // 验证最终结果
     EXPECT_EQ(sum, 10);
 }
+
+// 引用参数、异常和超出内联空间的大闭包
+TEST_F(ThreadPoolTest, TestSubmitRefExceptionAndLargeClosure) {
+    int out = 0;
+    pool_->Submit([](int &o, int v) { o = v; }, std::ref(out), 42).get();
+    EXPECT_EQ(out, 42);
+
+    auto failed = pool_->Submit([]() -> int { throw std::logic_error("bad"); });
+    EXPECT_THROW(failed.get(), std::logic_error);
+
+    std::array<int, 64> big;
+    big.fill(1);
+    auto sum = pool_->Submit([big]() {
+        int s = 0;
+        for (int v : big)
+            s += v;
+        return s;
+    });
+    EXPECT_EQ(sum.get(), 64);
+}
+
+class WorkStealingTest : public ::testing::Test {
+ public:
+    void SetUp() override {
+        pool_ = std::make_unique<ThreadPool>(4, ScheduleMode::kWorkStealing);
+    }
+    void TearDown() override { pool_->ShutDown(); }
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+TEST_F(WorkStealingTest, TestMatrixMultiplication) {
+    std::vector<std::vector<int>> A = {{1, 2, 3}, {4, 5, 6}};
+    std::vector<std::vector<int>> B = {{7, 8}, {9, 10}, {11, 12}};
+    std::vector<std::vector<int>> C = MatrixMultiply(A, B, *pool_);
+    std::vector<std::vector<int>> expected = {{58, 64}, {139, 154}};
+    EXPECT_EQ(C, expected);
+}
+
+// 工作线程内部提交的子任务进入本地队列，由自己或其他线程窃取执行
+TEST_F(WorkStealingTest, TestNestedSubmit) {
+    std::atomic<int> counter(0);
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < 8; ++i) {
+        futures.push_back(pool_->Submit([this, &counter]() {
+            for (int j = 0; j < 100; ++j) {
+                pool_->Submit([&counter]() { counter++; });
+            }
+        }));
+    }
+    for (auto &future : futures) {
+        future.get();
+    }
+    // ShutDown 会等待所有队列中的任务执行完毕
+    pool_->ShutDown();
+    EXPECT_EQ(counter.load(), 800);
+}
+
+TEST(TopologyTest, ParseAndAssign) {
+    EXPECT_EQ(ParseCpuList("0-3,8,10-11\n"),
+              (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_TRUE(ParseCpuList("").empty());
+
+    CpuTopology topo;
+    topo.node_cpus = {{0, 1, 2}, {4, 5, 6}};
+    EXPECT_EQ(AssignCpus(topo, PlacementPolicy::Compact(), 4),
+              (std::vector<int>{0, 1, 2, 4}));
+    EXPECT_EQ(AssignCpus(topo, PlacementPolicy::Scatter(), 4),
+              (std::vector<int>{0, 4, 1, 5}));
+    EXPECT_EQ(AssignCpus(topo, PlacementPolicy::Explicit({6, 2}), 3),
+              (std::vector<int>{6, 2, 6}));
+    EXPECT_EQ(AssignCpus(topo, PlacementPolicy::None(), 2),
+              (std::vector<int>{-1, -1}));
+    EXPECT_EQ(topo.NodeOf(5), 1);
+    EXPECT_EQ(topo.NodeId(1), 1);
+
+    // 节点编号不连续，下标是压缩后的编号
+    topo.node_ids = {0, 4};
+    EXPECT_EQ(topo.NodeId(1), 4);
+    EXPECT_EQ(topo.IndexOfNodeId(4), 1);
+    EXPECT_EQ(topo.IndexOfNodeId(1), -1);
+}
+
+// 绑核后的工作线程只在分配到的 CPU 上运行
+TEST(PlacementTest, PinnedWorkersAndNodeSubmit) {
+    CpuTopology topo = CpuTopology::Discover();
+    int first_cpu = topo.node_cpus[0][0];
+    for (ScheduleMode mode :
+         {ScheduleMode::kGlobalQueue, ScheduleMode::kWorkStealing}) {
+        ThreadPool pool(2, mode, PlacementPolicy::Explicit({first_cpu}));
+        EXPECT_EQ(pool.NodeCount(), topo.NodeCount());
+        for (int node = 0; node < topo.NodeCount(); ++node)
+            EXPECT_EQ(pool.NodeIndex(topo.NodeId(node)), node);
+        std::vector<std::future<int>> cpus;
+        for (int i = 0; i < 20; ++i)
+            cpus.push_back(pool.Submit([]() { return CurrentCpu(); }));
+        for (int node = 0; node < pool.NodeCount(); ++node)
+            cpus.push_back(pool.SubmitToNode(node, []() { return CurrentCpu(); }));
+        for (auto &cpu : cpus)
+            EXPECT_EQ(cpu.get(), first_cpu);
+        EXPECT_THROW(pool.SubmitToNode(pool.NodeCount(), []() {}),
+                     std::out_of_range);
+    }
+}
+
+// 工作窃取模式下嵌套的任务组在工作线程里等待，等待者帮忙执行排队的任务
+TEST_F(WorkStealingTest, TestTaskGroup) {
+    std::atomic<int> leaves(0);
+    TaskGroup outer(*pool_);
+    for (int i = 0; i < 16; ++i) {
+        outer.Run([this, &leaves]() {
+            TaskGroup inner(*pool_);
+            for (int j = 0; j < 16; ++j)
+                inner.Run([&leaves]() { leaves++; });
+            inner.Wait();
+        });
+    }
+    outer.Wait();
+    EXPECT_EQ(leaves.load(), 256);
+
+    outer.Run([]() { throw std::runtime_error("task failed"); });
+    outer.Run([&leaves]() { leaves++; });
+    EXPECT_THROW(outer.Wait(), std::runtime_error);
+    outer.Run([&leaves]() { leaves = 0; });
+    outer.Wait();
+    EXPECT_EQ(leaves.load(), 0);
+}
+
+// 递归分治：工作线程等待子任务时先执行待处理的任务，两个线程也不会死锁
+int ParallelFib(ThreadPool &pool, int n) {
+    if (n < 12) {
+        int a = 0, b = 1;
+        for (int i = 0; i < n; ++i) {
+            int next = a + b;
+            a = b;
+            b = next;
+        }
+        return a;
+    }
+    std::future<int> left =
+        pool.Submit([&pool, n]() { return ParallelFib(pool, n - 1); });
+    int right = ParallelFib(pool, n - 2);
+    return pool.Get(left) + right;
+}
+
+TEST(HelpWhileWaitingTest, NestedWaitsDoNotDeadlock) {
+    for (ScheduleMode mode :
+         {ScheduleMode::kGlobalQueue, ScheduleMode::kWorkStealing}) {
+        ThreadPool pool(2, mode);
+        auto root = pool.Submit([&pool]() { return ParallelFib(pool, 24); });
+        EXPECT_EQ(pool.Get(root), 46368);
+
+        // 子任务的异常通过 Get 传回等待的任务
+        auto failed = pool.Submit([&pool]() {
+            auto child = pool.Submit([]() -> int { throw std::runtime_error("child"); });
+            return pool.Get(child);
+        });
+        EXPECT_THROW(failed.get(), std::runtime_error);
+    }
+}
+
+// 父节点取消后，子节点上排队的任务不再执行
+TEST(CancellationTest, CancelledTasksAreDropped) {
+    ThreadPool pool(1);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    auto blocker = pool.Submit([opened]() { opened.wait(); });
+
+    CancellationSource request;
+    CancellationSource sub(request.Token());
+    std::atomic<int> ran(0);
+    std::vector<std::future<void>> dropped;
+    for (int i = 0; i < 8; ++i)
+        dropped.push_back(pool.Submit(i % 2 ? sub.Token() : request.Token(),
+                                      [&ran]() { ran++; }));
+    auto kept = pool.Submit(CancellationToken(), [](int v) { return v * 2; }, 21);
+    request.Cancel();
+    gate.set_value();
+
+    blocker.get();
+    for (auto &f : dropped)
+        EXPECT_THROW(f.get(), TaskCancelled);
+    EXPECT_EQ(kept.get(), 42);
+    EXPECT_EQ(ran.load(), 0);
+    EXPECT_TRUE(sub.IsCancelled());
+    EXPECT_THROW(pool.Submit(sub.Token(), []() {}).get(), TaskCancelled);
+}
 #endif
 
 #if 1
@@ -1,6 +1,7 @@
 #include"threadPool.h"
 #include <iostream> 
 #include <random> 
+#include <functional>
 std::random_device rd; //真实随机数产生器
 std::mt19937 mt(rd()); //生成计算随机数mt;
 std::uniform_int_distribution<int> dist(-1000, 1000);//生成-1000到1000之间的离散均匀分部数
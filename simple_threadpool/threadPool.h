@@ -2,29 +2,86 @@
 #define THREADPOOL_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 
+#include "cancellation.h"
+#include "coro_task.h"
+#include "inline_task.h"
+#include "topology.h"
+#include "work_stealing_deque.h"
+
+// 调度模式
+enum class ScheduleMode {
+    kGlobalQueue,  // 所有线程共享一个加锁的任务队列
+    kWorkStealing, // 每个线程一个本地双端队列，空闲时随机窃取
+};
+
 class ThreadPool {
  public:
-    ThreadPool(int size = std::thread::hardware_concurrency())
-        : pool_size_(size), isStop_(false) {
+    // placement 不为 kNone 时按策略把工作线程绑定到 CPU 上，
+    // 窃取模式下还会为每个 NUMA 节点建立独立的注入队列
+    ThreadPool(int size = std::thread::hardware_concurrency(),
+               ScheduleMode mode = ScheduleMode::kGlobalQueue,
+               const PlacementPolicy &placement = PlacementPolicy::None())
+        : pool_size_(size), isStop_(false), mode_(mode), queued_tasks_(0),
+          sleepers_(0), node_count_(1) {
+        std::vector<int> cpus(pool_size_, -1);
+        worker_node_.assign(pool_size_, 0);
+        if (placement.kind != Placement::kNone) {
+            CpuTopology topo = CpuTopology::Discover();
+            cpus = AssignCpus(topo, placement, pool_size_);
+            node_count_ = topo.NodeCount();
+            for (int node = 0; node < node_count_; ++node) {
+                node_ids_.push_back(topo.NodeId(node));
+                for (int cpu : topo.node_cpus[node]) {
+                    if (cpu >= static_cast<int>(cpu_node_.size()))
+                        cpu_node_.resize(cpu + 1, 0);
+                    cpu_node_[cpu] = node;
+                }
+            }
+            for (int i = 0; i < pool_size_; ++i)
+                worker_node_[i] = nodeOfCpu(cpus[i]);
+        }
+        if (mode_ == ScheduleMode::kWorkStealing) {
+            for (int i = 0; i < pool_size_; ++i) {
+                local_queues_.emplace_back(new WorkStealingDeque<Task *>());
+            }
+            for (int node = 0; node < node_count_; ++node) {
+                node_queues_.emplace_back(new NodeQueue());
+            }
+        }
         for (int i = 0; i < pool_size_; ++i) {
             // threads_.push_back(std::thread(&ThreadPool::worker,this));
-            threads_.emplace_back([this]() { worker(); });
+            int cpu = cpus[i];
+            if (mode_ == ScheduleMode::kWorkStealing)
+                threads_.emplace_back([this, i, cpu]() {
+                    if (cpu >= 0)
+                        PinCurrentThread(cpu);
+                    stealingWorker(i);
+                });
+            else
+                threads_.emplace_back([this, i, cpu]() {
+                    if (cpu >= 0)
+                        PinCurrentThread(cpu);
+                    worker(i);
+                });
         }
     }
 
     ~ThreadPool() { ShutDown(); }
 
     void ShutDown() {
-        isStop_ = true;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            isStop_ = true;
+        }
 
         not_empty_cond_.notify_all();
 
@@ -37,34 +94,180 @@ class ThreadPool {
     template <typename F, typename... Args>
     auto Submit(F &&f, Args &&...args) -> std::future<decltype(f(args...))> {
         using func_type = decltype(f(args...));
-        auto task_ptr = std::make_shared<std::packaged_task<func_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-        std::future<func_type> func_future = task_ptr->get_future();
+        // promise 的共享状态从内存池分配，闭包直接存放在任务对象内部
+        std::promise<func_type> promise = MakePooledPromise<func_type>();
+        std::future<func_type> func_future = promise.get_future();
+        Task task = MakePromiseTask(std::move(promise), std::forward<F>(f),
+                                    std::forward<Args>(args)...);
+        enqueue(std::move(task));
+        return func_future;
+    }
 
-        {
-            std::lock_guard<std::mutex> lock(mtx_);
-            if (isStop_)
-                throw std::runtime_error("threadpool has stop!!!");
-            task_queue_.emplace([task_ptr]() { (*task_ptr)(); });
+    // 可取消的提交：任务出队时 token 已经取消则直接丢弃，future 得到 TaskCancelled
+    // 提交时已经取消的任务不进入队列；执行中的任务可以自行检查 token.IsCancelled()
+    template <typename F, typename... Args>
+    auto Submit(const CancellationToken &token, F &&f, Args &&...args)
+        -> std::future<decltype(f(args...))> {
+        using func_type = decltype(f(args...));
+        std::promise<func_type> promise = MakePooledPromise<func_type>();
+        std::future<func_type> func_future = promise.get_future();
+        if (token.IsCancelled()) {
+            promise.set_exception(std::make_exception_ptr(TaskCancelled()));
+            return func_future;
         }
-        not_empty_cond_.notify_one();
+        Task task = MakeCancellableTask(token, std::move(promise), std::forward<F>(f),
+                                        std::forward<Args>(args)...);
+        enqueue(std::move(task));
+        return func_future;
+    }
 
+    // 提交到指定 NUMA 节点的队列，优先由该节点上的工作线程执行
+    // node 是 [0, NodeCount()) 内的下标，不是操作系统的节点编号，用 NodeIndex 转换
+    // 共享队列模式下只有一个队列，node 只做范围检查
+    template <typename F, typename... Args>
+    auto SubmitToNode(int node, F &&f, Args &&...args)
+        -> std::future<decltype(f(args...))> {
+        if (node < 0 || node >= node_count_)
+            throw std::out_of_range("numa node out of range");
+        using func_type = decltype(f(args...));
+        std::promise<func_type> promise = MakePooledPromise<func_type>();
+        std::future<func_type> func_future = promise.get_future();
+        Task task = MakePromiseTask(std::move(promise), std::forward<F>(f),
+                                    std::forward<Args>(args)...);
+        enqueue(std::move(task), node);
         return func_future;
     }
 
+    // 等待 future 的结果。在本线程池的工作线程中调用时，结果就绪之前先执行其他待处理任务
+    // （窃取模式下优先执行本线程刚提交的子任务），而不是阻塞工作线程，
+    // 固定大小的线程池里递归地提交并等待子任务也不会死锁
+    // 其他线程调用时等同于 future.get()
+    template <typename FutureType> auto Get(FutureType &future) -> decltype(future.get()) {
+        WorkerContext &ctx = currentWorker();
+        if (ctx.pool == this) {
+            uint32_t seed = static_cast<uint32_t>(ctx.index) * 2654435761u + 7;
+            while (future.wait_for(std::chrono::seconds(0)) !=
+                   std::future_status::ready) {
+                // 没有可执行的任务时，等待的子任务正在其他线程上运行，阻塞到它完成即可，不再轮询
+                if (!runPendingTask(ctx.index, seed)) {
+                    future.wait();
+                    break;
+                }
+            }
+        }
+        return future.get();
+    }
+
+    // 参与调度的 NUMA 节点数，不绑核时为 1
+    int NodeCount() const { return node_count_; }
+
+    // 操作系统编号为 id 的节点在 SubmitToNode 中使用的下标，
+    // 节点不参与调度（例如只有内存、没有可用 CPU）时返回 -1
+    int NodeIndex(int id) const {
+        if (node_ids_.empty())
+            return id == 0 ? 0 : -1;
+        for (int node = 0; node < node_count_; ++node) {
+            if (node_ids_[node] == id)
+                return node;
+        }
+        return -1;
+    }
+
+    // 提交不关心返回值的任务，不创建 promise/future
+    template <typename F> void Post(F &&f) { enqueue(Task(std::forward<F>(f))); }
+
+    // 在本线程池的工作线程中调用时执行一个待处理任务，其他线程调用或没有任务时返回 false
+    // 供 TaskGroup 这类等待者在等待期间帮忙执行
+    bool TryRunPending() {
+        WorkerContext &ctx = currentWorker();
+        if (ctx.pool != this)
+            return false;
+        uint32_t seed = static_cast<uint32_t>(ctx.index) * 2654435761u + 7;
+        return runPendingTask(ctx.index, seed);
+    }
+
+#if __cplusplus >= 202002L
+    // 在协程中 co_await pool.Schedule()，之后的代码在工作线程上执行
+    coro::ScheduleAwaitable<ThreadPool> Schedule() {
+        return coro::ScheduleAwaitable<ThreadPool>(*this);
+    }
+#endif
+
  private:
     std::atomic_bool isStop_;
     int pool_size_;
+    ScheduleMode mode_;
 
-    using Task = std::function<void()>;
+    using Task = InlineTask;
 
     std::vector<std::thread> threads_;
-    std::queue<Task> task_queue_;
+    // 共享队列模式下的任务队列
+    TaskQueue task_queue_;
 
     std::mutex mtx_;
     std::condition_variable not_empty_cond_;
 
-    void worker() {
+    /* 工作窃取模式 */
+    // 每个工作线程的本地队列，下标与线程编号一致
+    std::vector<std::unique_ptr<WorkStealingDeque<Task *>>> local_queues_;
+    // 所有队列中尚未被取走的任务总数，用于判断线程能否休眠
+    std::atomic<int64_t> queued_tasks_;
+    // 正在条件变量上休眠的线程数，为0时提交者无需通知
+    std::atomic<int> sleepers_;
+
+    /* NUMA 节点 */
+    // 每个节点一个外部提交的注入队列，各自加锁，互不争用
+    struct NodeQueue {
+        std::mutex mtx;
+        TaskQueue tasks;
+        std::atomic<int64_t> size{0}; // 用于不加锁地跳过空队列
+    };
+    std::vector<std::unique_ptr<NodeQueue>> node_queues_;
+    int node_count_;
+    std::vector<int> node_ids_; // 每个节点的操作系统编号，不绑核时为空
+    // CPU 编号到节点编号的映射，以及每个工作线程所在的节点
+    std::vector<int> cpu_node_;
+    std::vector<int> worker_node_;
+
+    int nodeOfCpu(int cpu) const {
+        if (cpu < 0 || cpu >= static_cast<int>(cpu_node_.size()))
+            return 0;
+        return cpu_node_[cpu];
+    }
+
+    // 提交者当前所在的节点，任务优先放到这个节点的队列中
+    int submitterNode() const {
+        return node_count_ == 1 ? 0 : nodeOfCpu(CurrentCpu());
+    }
+
+    struct WorkerContext {
+        ThreadPool *pool = nullptr;
+        int index = -1;
+    };
+    // 当前线程所属的线程池及其编号，用于识别任务内部的嵌套提交和等待
+    static WorkerContext &currentWorker() {
+        static thread_local WorkerContext ctx;
+        return ctx;
+    }
+
+    // node 为 -1 时使用提交者所在的节点
+    void enqueue(Task &&task, int node = -1) {
+        if (mode_ == ScheduleMode::kWorkStealing) {
+            pushStealing(std::move(task), node);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (isStop_)
+                throw std::runtime_error("threadpool has stop!!!");
+            task_queue_.push(std::move(task));
+        }
+        not_empty_cond_.notify_one();
+    }
+
+    void worker(int index) {
+        currentWorker() = {this, index};
         while (1) {
             std::unique_lock<std::mutex> lock(mtx_);
 
@@ -72,16 +275,148 @@ class ThreadPool {
                 lock, [this]() { return isStop_ || !task_queue_.empty(); });
 
             if (isStop_ && task_queue_.empty())
-                return;
+                break;
 
-            Task task = task_queue_.front();
+            Task task = std::move(task_queue_.front());
             task_queue_.pop();
 
             lock.unlock();
 
             task();
         }
-        return;
+        currentWorker() = {};
+    }
+
+    // 工作线程等待时执行一个待处理任务，没有任务可执行时返回 false
+    bool runPendingTask(int index, uint32_t &seed) {
+        Task task;
+        if (mode_ == ScheduleMode::kWorkStealing) {
+            if (!findTask(index, seed, task))
+                return false;
+            queued_tasks_.fetch_sub(1);
+        } else {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (task_queue_.empty())
+                return false;
+            task = std::move(task_queue_.front());
+            task_queue_.pop();
+        }
+        task();
+        return true;
+    }
+
+    // 本地队列中只能存放指针，任务节点同样从内存池分配
+    static Task *newTask(Task &&task) {
+        Task *ptr = PoolAllocator<Task>().allocate(1);
+        return ::new (static_cast<void *>(ptr)) Task(std::move(task));
+    }
+    static void deleteTask(Task *ptr) {
+        ptr->~Task();
+        PoolAllocator<Task>().deallocate(ptr, 1);
+    }
+
+    void pushStealing(Task task, int node) {
+        WorkerContext &ctx = currentWorker();
+        if (ctx.pool == this && (node < 0 || node == worker_node_[ctx.index])) {
+            // 工作线程内部提交：放入自己的本地队列，无需加锁
+            if (isStop_)
+                throw std::runtime_error("threadpool has stop!!!");
+            local_queues_[ctx.index]->Push(newTask(std::move(task)));
+        } else {
+            // 外部提交：放入节点的注入队列
+            if (node < 0)
+                node = submitterNode();
+            NodeQueue &queue = *node_queues_[node];
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            if (isStop_)
+                throw std::runtime_error("threadpool has stop!!!");
+            queue.tasks.push(std::move(task));
+            queue.size.fetch_add(1);
+        }
+        queued_tasks_.fetch_add(1);
+        if (sleepers_.load() > 0) {
+            // 加锁保证休眠者要么已经进入等待，要么能看到新的任务计数
+            { std::lock_guard<std::mutex> lock(mtx_); }
+            not_empty_cond_.notify_one();
+        }
+    }
+
+    bool popNode(int node, Task &task) {
+        NodeQueue &queue = *node_queues_[node];
+        if (queue.size.load(std::memory_order_relaxed) == 0)
+            return false;
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        if (queue.tasks.empty())
+            return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop();
+        queue.size.fetch_sub(1);
+        return true;
+    }
+
+    // 依次尝试：本地队列 -> 本节点注入队列 -> 窃取本节点的线程
+    //        -> 其他节点的注入队列 -> 窃取其他节点的线程
+    bool findTask(int index, uint32_t &seed, Task &task) {
+        Task *task_ptr = nullptr;
+        if (local_queues_[index]->Pop(task_ptr)) {
+            task = std::move(*task_ptr);
+            deleteTask(task_ptr);
+            return true;
+        }
+
+        int home = worker_node_[index];
+        if (popNode(home, task))
+            return true;
+
+        for (int pass = 0; pass < (node_count_ > 1 ? 2 : 1); ++pass) {
+            if (pass == 1) {
+                for (int i = 1; i < node_count_; ++i) {
+                    if (popNode((home + i) % node_count_, task))
+                        return true;
+                }
+            }
+            // xorshift 随机选择起始受害者，依次尝试一轮
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            int start = static_cast<int>(seed % pool_size_);
+            for (int i = 0; i < pool_size_; ++i) {
+                int victim = (start + i) % pool_size_;
+                if (victim == index || (worker_node_[victim] == home) != (pass == 0))
+                    continue;
+                if (local_queues_[victim]->Steal(task_ptr)) {
+                    task = std::move(*task_ptr);
+                    deleteTask(task_ptr);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void stealingWorker(int index) {
+        currentWorker() = {this, index};
+        uint32_t seed = static_cast<uint32_t>(index) * 2654435761u + 1;
+
+        while (1) {
+            Task task;
+            if (findTask(index, seed, task)) {
+                queued_tasks_.fetch_sub(1);
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mtx_);
+            // 本地队列已空，停止后其他线程无法再提交，可以安全退出
+            if (isStop_ && queued_tasks_.load() == 0)
+                break;
+            ++sleepers_;
+            not_empty_cond_.wait(lock, [this]() {
+                return isStop_ || queued_tasks_.load() > 0;
+            });
+            --sleepers_;
+        }
+        currentWorker() = {};
     }
 };
 
@@ -0,0 +1,202 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// 解析 /sys 中的 cpulist 格式，例如 "0-3,8,10-11"
+inline std::vector<int> ParseCpuList(const std::string &list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        size_t dash = item.find('-');
+        if (!item.empty() && item[0] >= '0' && item[0] <= '9') {
+            int first = std::atoi(item.c_str());
+            int last = dash == std::string::npos
+                           ? first
+                           : std::atoi(item.c_str() + dash + 1);
+            for (int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+// NUMA 拓扑：每个节点包含哪些 CPU
+// 节点下标是压缩后的编号，只包含有可用 CPU 的节点，与操作系统的节点编号不一定相同，
+// 两者之间用 NodeId/IndexOfNodeId 转换
+struct CpuTopology {
+    std::vector<std::vector<int>> node_cpus;
+    std::vector<int> node_ids; // 每个节点在操作系统中的编号，为空时与下标相同
+
+    int NodeCount() const { return static_cast<int>(node_cpus.size()); }
+
+    // 下标为 node 的节点在操作系统中的编号
+    int NodeId(int node) const {
+        return node < static_cast<int>(node_ids.size()) ? node_ids[node] : node;
+    }
+
+    // 操作系统编号为 id 的节点的下标，节点不存在或者没有可用 CPU 时返回 -1
+    int IndexOfNodeId(int id) const {
+        for (int node = 0; node < NodeCount(); ++node) {
+            if (NodeId(node) == id)
+                return node;
+        }
+        return -1;
+    }
+
+    // cpu 所在的节点，未知时返回 0
+    int NodeOf(int cpu) const {
+        for (int node = 0; node < NodeCount(); ++node) {
+            const auto &cpus = node_cpus[node];
+            if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end())
+                return node;
+        }
+        return 0;
+    }
+
+    // 从 /sys/devices/system/node 读取拓扑，只保留当前进程允许使用的 CPU
+    // 节点编号可能不连续，按 online 列表逐个读取；读取失败或不是 Linux 时视为只有一个节点
+    static CpuTopology Discover() {
+        CpuTopology topo;
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool has_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+        std::string online;
+        std::ifstream online_in("/sys/devices/system/node/online");
+        std::getline(online_in, online);
+        // online 与 cpulist 格式相同，例如 "0-1,4"
+        for (int id : ParseCpuList(online)) {
+            std::ifstream in("/sys/devices/system/node/node" +
+                             std::to_string(id) + "/cpulist");
+            if (!in)
+                continue;
+            std::string line;
+            std::getline(in, line);
+            std::vector<int> cpus;
+            for (int cpu : ParseCpuList(line)) {
+                if (!has_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+                    cpus.push_back(cpu);
+            }
+            // 没有可用 CPU 的节点（例如只有内存的节点）不参与调度
+            if (!cpus.empty()) {
+                topo.node_cpus.push_back(cpus);
+                topo.node_ids.push_back(id);
+            }
+        }
+        if (topo.node_cpus.empty() && has_mask) {
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+            }
+            topo.node_cpus.push_back(cpus);
+        }
+#endif
+        if (topo.node_cpus.empty()) {
+            std::vector<int> cpus;
+            int n = std::max(1u, std::thread::hardware_concurrency());
+            for (int cpu = 0; cpu < n; ++cpu)
+                cpus.push_back(cpu);
+            topo.node_cpus.push_back(cpus);
+        }
+        return topo;
+    }
+};
+
+// 工作线程的绑核策略
+enum class Placement {
+    kNone,     // 不绑核，由操作系统调度
+    kCompact,  // 先占满一个节点的 CPU，再使用下一个节点
+    kScatter,  // 依次轮流放到各个节点上
+    kExplicit, // 按给定的 CPU 列表依次绑定
+};
+
+struct PlacementPolicy {
+    Placement kind = Placement::kNone;
+    std::vector<int> cpus; // kExplicit 时使用
+
+    static PlacementPolicy None() { return {}; }
+    static PlacementPolicy Compact() { return {Placement::kCompact, {}}; }
+    static PlacementPolicy Scatter() { return {Placement::kScatter, {}}; }
+    static PlacementPolicy Explicit(std::vector<int> cpus) {
+        return {Placement::kExplicit, std::move(cpus)};
+    }
+};
+
+// 为 workers 个工作线程分配 CPU，-1 表示不绑核
+// 线程数多于 CPU 数时循环使用
+inline std::vector<int> AssignCpus(const CpuTopology &topo,
+                                   const PlacementPolicy &policy, int workers) {
+    std::vector<int> order;
+    switch (policy.kind) {
+    case Placement::kNone:
+        break;
+    case Placement::kCompact:
+        for (const auto &cpus : topo.node_cpus)
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        break;
+    case Placement::kScatter: {
+        size_t longest = 0;
+        for (const auto &cpus : topo.node_cpus)
+            longest = std::max(longest, cpus.size());
+        for (size_t i = 0; i < longest; ++i) {
+            for (const auto &cpus : topo.node_cpus) {
+                if (i < cpus.size())
+                    order.push_back(cpus[i]);
+            }
+        }
+        break;
+    }
+    case Placement::kExplicit:
+        order = policy.cpus;
+        break;
+    }
+    std::vector<int> assigned(workers, -1);
+    if (!order.empty()) {
+        for (int i = 0; i < workers; ++i)
+            assigned[i] = order[i % order.size()];
+    }
+    return assigned;
+}
+
+// 把当前线程绑定到 cpu 上，失败或不支持时返回 false
+inline bool PinCurrentThread(int cpu) {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// 当前线程正在运行的 CPU，未知时返回 -1
+inline int CurrentCpu() {
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+#endif // TOPOLOGY_H
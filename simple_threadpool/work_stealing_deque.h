@@ -0,0 +1,125 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Chase-Lev 工作窃取双端队列
+// 只有所属线程可以调用 Push/Pop（在底部操作，LIFO），
+// 其他线程只能调用 Steal（从顶部窃取，FIFO）。
+// 内存序参考 Lê 等人的《Correct and Efficient Work-Stealing for Weak Memory Models》。
+// T 必须是可平凡拷贝的类型（一般存放任务指针）。
+template <typename T>
+class WorkStealingDeque {
+ public:
+    explicit WorkStealingDeque(int64_t capacity = 256)
+        : top_(0), bottom_(0) {
+        int64_t cap = 1;
+        while (cap < capacity)
+            cap <<= 1;
+        garbage_.emplace_back(new Array(cap));
+        array_.store(garbage_.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // 仅所属线程调用：压入底部，容量不足时扩容
+    void Push(T item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array *a = array_.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) {
+            a = Grow(a, b, t);
+        }
+        a->Put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // 仅所属线程调用：从底部弹出最近压入的任务
+    bool Pop(T &item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array *a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // 队列为空，恢复 bottom
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = a->Get(b);
+        if (t == b) {
+            // 只剩最后一个元素，需要和窃取者竞争
+            bool won = top_.compare_exchange_strong(
+                t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // 任意线程调用：从顶部窃取最早压入的任务
+    bool Steal(T &item) {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+
+        Array *a = array_.load(std::memory_order_acquire);
+        T tmp = a->Get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+            return false;
+        item = tmp;
+        return true;
+    }
+
+    // 近似大小，仅用于统计和调度提示
+    int64_t Size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+    bool Empty() const { return Size() == 0; }
+
+ private:
+    struct Array {
+        explicit Array(int64_t cap)
+            : capacity(cap), mask(cap - 1), buffer(new std::atomic<T>[cap]) {}
+
+        T Get(int64_t i) const {
+            return buffer[i & mask].load(std::memory_order_relaxed);
+        }
+        void Put(int64_t i, T item) {
+            buffer[i & mask].store(item, std::memory_order_relaxed);
+        }
+
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> buffer;
+    };
+
+    Array *Grow(Array *old, int64_t b, int64_t t) {
+        Array *a = new Array(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i)
+            a->Put(i, old->Get(i));
+        // 旧数组可能仍被窃取者读取，延迟到析构时释放
+        garbage_.emplace_back(a);
+        array_.store(a, std::memory_order_release);
+        return a;
+    }
+
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    std::atomic<Array *> array_;
+    std::vector<std::unique_ptr<Array>> garbage_;
+};
+
+#endif // WORK_STEALING_DEQUE_H
@@ -0,0 +1,545 @@
+#ifndef __ASYNC_FUTURE__
+#define __ASYNC_FUTURE__
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.h"
+
+#if __cplusplus >= 202002L
+#include <coroutine>
+#endif
+
+// Future 和 Promise 共享的状态
+// 完成时依次调用登记的回调，回调只做计数或把后续任务投递到线程池，不会阻塞
+template<typename T>
+struct FutureState {
+    using Storage = typename std::conditional<std::is_void<T>::value, char, T>::type;
+
+    explicit FutureState(ThreadPool* pool) : pool(pool) {}
+
+    // 设置结果并唤醒等待者，然后在锁外调用回调
+    template<typename... U>
+    void SetValue(U&&... value) {
+        std::vector<InlineTask> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (ready) throw std::future_error(std::future_errc::promise_already_satisfied);
+            this->value.emplace(std::forward<U>(value)...);
+            ready = true;
+            callbacks.swap(this->callbacks);
+        }
+        cond.notify_all();
+        for (auto& callback : callbacks) callback();
+    }
+
+    void SetException(std::exception_ptr e) {
+        std::vector<InlineTask> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (ready) throw std::future_error(std::future_errc::promise_already_satisfied);
+            error = e;
+            ready = true;
+            callbacks.swap(this->callbacks);
+        }
+        cond.notify_all();
+        for (auto& callback : callbacks) callback();
+    }
+
+    // 完成后调用 callback；已经完成时在当前线程立即调用
+    void OnReady(InlineTask callback) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!ready) {
+                callbacks.push_back(std::move(callback));
+                return;
+            }
+        }
+        callback();
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mtx);
+        cond.wait(lock, [this]() { return ready; });
+    }
+
+    ThreadPool* pool;  // 后续任务投递到的线程池，为空时在完成的线程上直接执行
+    std::mutex mtx;
+    std::condition_variable cond;
+    bool ready = false;
+    std::optional<Storage> value;
+    std::exception_ptr error;
+    std::vector<InlineTask> callbacks;
+};
+
+template<typename T>
+class Promise;
+
+// Then 的返回值类型：前一个结果为 void 时 fn 不带参数
+template<typename F, typename T>
+struct ThenResult {
+    using type = typename std::invoke_result<F&, T&&>::type;
+};
+
+template<typename F>
+struct ThenResult<F, void> {
+    using type = typename std::invoke_result<F&>::type;
+};
+
+// 可以挂接后续任务的 future
+// 与 std::future 一样只能取一次结果：Get 和 Then 都会使 Future 失效
+template<typename T>
+class Future {
+public:
+    using value_type = T;
+
+    Future() = default;
+    Future(Future&&) noexcept = default;
+    Future& operator=(Future&&) noexcept = default;
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    bool Valid() const { return state_ != nullptr; }
+
+    bool Ready() const {
+        CheckValid();
+        std::lock_guard<std::mutex> lock(state_->mtx);
+        return state_->ready;
+    }
+
+    void Wait() const {
+        CheckValid();
+        state_->Wait();
+    }
+
+    // 阻塞等待结果，任务抛出的异常在这里重新抛出
+    T Get() {
+        CheckValid();
+        auto state = std::move(state_);
+        state->Wait();
+        if (state->error) std::rethrow_exception(state->error);
+        if constexpr (!std::is_void<T>::value) {
+            return std::move(*state->value);
+        }
+    }
+
+    // 结果就绪后把 fn(结果) 投递到线程池执行，不阻塞任何线程
+    // 前一个任务抛出异常时不调用 fn，异常直接传递给返回的 Future
+    template<typename F>
+    auto Then(F&& fn);
+
+    // 结果就绪时调用 callback，只用于 WhenAll/WhenAny 这类不消耗结果的组合
+    void OnReady(InlineTask callback) const {
+        CheckValid();
+        state_->OnReady(std::move(callback));
+    }
+
+    ThreadPool* Pool() const {
+        CheckValid();
+        return state_->pool;
+    }
+
+private:
+    template<typename> friend class Promise;
+    template<typename> friend class Future;
+
+    explicit Future(std::shared_ptr<FutureState<T>> state) : state_(std::move(state)) {}
+
+    void CheckValid() const {
+        if (!state_) throw std::future_error(std::future_errc::no_state);
+    }
+
+    std::shared_ptr<FutureState<T>> state_;
+};
+
+template<typename T>
+class Promise {
+public:
+    explicit Promise(ThreadPool* pool = nullptr)
+        : state_(std::make_shared<FutureState<T>>(pool)) {}
+    Promise(Promise&&) noexcept = default;
+    Promise& operator=(Promise&& other) noexcept {
+        if (this != &other) {
+            Abandon();
+            state_ = std::move(other.state_);
+        }
+        return *this;
+    }
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+
+    // 没有设置结果就析构时，等待者得到 broken_promise
+    ~Promise() { Abandon(); }
+
+    Future<T> GetFuture() { return Future<T>(state_); }
+
+    template<typename... U>
+    void SetValue(U&&... value) {
+        state_->SetValue(std::forward<U>(value)...);
+        state_.reset();
+    }
+
+    void SetException(std::exception_ptr e) {
+        state_->SetException(e);
+        state_.reset();
+    }
+
+private:
+    void Abandon() {
+        if (!state_) return;
+        auto state = std::move(state_);
+        {
+            std::lock_guard<std::mutex> lock(state->mtx);
+            if (state->ready) return;
+        }
+        state->SetException(std::make_exception_ptr(
+            std::future_error(std::future_errc::broken_promise)));
+    }
+
+    std::shared_ptr<FutureState<T>> state_;
+};
+
+// 调用 fn(args...) 并把结果或异常写入 promise
+template<typename T, typename F, typename... Args>
+void FulfillPromise(Promise<T>& promise, F& fn, Args&&... args) {
+    try {
+        if constexpr (std::is_void<T>::value) {
+            fn(std::forward<Args>(args)...);
+            promise.SetValue();
+        } else {
+            promise.SetValue(fn(std::forward<Args>(args)...));
+        }
+    } catch (...) {
+        promise.SetException(std::current_exception());
+    }
+}
+
+template<typename T>
+template<typename F>
+auto Future<T>::Then(F&& fn) {
+    CheckValid();
+    using Fn = typename std::decay<F>::type;
+    using R = typename ThenResult<Fn, T>::type;
+    auto state = std::move(state_);
+    ThreadPool* pool = state->pool;
+    Promise<R> next(pool);
+    Future<R> result = next.GetFuture();
+    auto run = [state, next = std::move(next), fn = std::forward<F>(fn)]() mutable {
+        if (state->error) {
+            next.SetException(state->error);
+            return;
+        }
+        if constexpr (std::is_void<T>::value) {
+            FulfillPromise(next, fn);
+        } else {
+            FulfillPromise(next, fn, std::move(*state->value));
+        }
+    };
+    state->OnReady([pool, run = std::move(run)]() mutable {
+        if (pool) {
+            pool->Post(std::move(run));
+        } else {
+            run();
+        }
+    });
+    return result;
+}
+
+// 所有 Future 都完成后就绪，结果是原来的 Future 列表，此时对它们调用 Get 不会阻塞
+template<typename T>
+Future<std::vector<Future<T>>> WhenAll(std::vector<Future<T>> futures) {
+    using Result = std::vector<Future<T>>;
+    struct Context {
+        explicit Context(ThreadPool* pool) : promise(pool) {}
+        Result futures;
+        std::atomic<size_t> remaining{0};
+        Promise<Result> promise;
+
+        void Arrive() {
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                promise.SetValue(std::move(futures));
+            }
+        }
+    };
+    ThreadPool* pool = futures.empty() ? nullptr : futures.front().Pool();
+    auto ctx = std::make_shared<Context>(pool);
+    Future<Result> result = ctx->promise.GetFuture();
+    // 多计一次，保证列表移入 ctx 之前不会有回调把它取走
+    ctx->remaining.store(futures.size() + 1, std::memory_order_relaxed);
+    for (auto& future : futures) {
+        future.OnReady([ctx]() { ctx->Arrive(); });
+    }
+    ctx->futures = std::move(futures);
+    ctx->Arrive();
+    return result;
+}
+
+template<typename T>
+struct WhenAnyResult {
+    size_t index;                   // 最先完成的 Future 的下标
+    std::vector<Future<T>> futures;
+};
+
+// 任意一个 Future 完成后就绪，结果中记录最先完成的下标
+template<typename T>
+Future<WhenAnyResult<T>> WhenAny(std::vector<Future<T>> futures) {
+    using Result = WhenAnyResult<T>;
+    if (futures.empty()) {
+        throw std::invalid_argument("WhenAny requires at least one future");
+    }
+    struct Context {
+        explicit Context(ThreadPool* pool) : promise(pool) {}
+        std::vector<Future<T>> futures;
+        std::atomic<bool> won{false};
+        size_t index = 0;
+        // 第一个完成的回调和登记结束各到达一次，后到达的一方设置结果
+        std::atomic<int> arrivals{2};
+        Promise<Result> promise;
+
+        void Arrive() {
+            if (arrivals.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                promise.SetValue(Result{index, std::move(futures)});
+            }
+        }
+    };
+    auto ctx = std::make_shared<Context>(futures.front().Pool());
+    Future<Result> result = ctx->promise.GetFuture();
+    for (size_t i = 0; i < futures.size(); ++i) {
+        futures[i].OnReady([ctx, i]() {
+            if (!ctx->won.exchange(true, std::memory_order_acq_rel)) {
+                ctx->index = i;
+                ctx->Arrive();
+            }
+        });
+    }
+    ctx->futures = std::move(futures);
+    ctx->Arrive();
+    return result;
+}
+
+template<typename T>
+T ThreadPool::Get(Future<T>& future) {
+    WorkerContext& ctx = CurrentWorker();
+    if (ctx.pool == this) {
+        while (!future.Ready()) {
+            // 队列为空时等待的任务正在其他线程上运行，在 Future 的条件变量上阻塞到它完成
+            if (!RunPendingTask(ctx.stats)) {
+                future.Wait();
+                break;
+            }
+        }
+    }
+    return future.Get();
+}
+
+template<typename F, typename... Args>
+auto ThreadPool::SubmitAsync(F&& f, Args&&... args)
+    -> Future<decltype(f(args...))> {
+    using ret_type = decltype(f(args...));
+    Promise<ret_type> promise(this);
+    Future<ret_type> future = promise.GetFuture();
+    Post([promise = std::move(promise), func = std::forward<F>(f),
+          bound = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+        auto call = [&func, &bound]() -> ret_type { return std::apply(func, bound); };
+        FulfillPromise(promise, call);
+    });
+    return future;
+}
+
+template<typename F, typename... Args>
+auto ThreadPool::SubmitAsync(const CancellationToken& token, F&& f, Args&&... args)
+    -> Future<decltype(f(args...))> {
+    using ret_type = decltype(f(args...));
+    Promise<ret_type> promise(this);
+    Future<ret_type> future = promise.GetFuture();
+    if (token.IsCancelled()) {
+        promise.SetException(std::make_exception_ptr(TaskCancelled()));
+        return future;
+    }
+    Post([token, promise = std::move(promise), func = std::forward<F>(f),
+          bound = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+        if (token.IsCancelled()) {
+            promise.SetException(std::make_exception_ptr(TaskCancelled()));
+            return;
+        }
+        auto call = [&func, &bound]() -> ret_type { return std::apply(func, bound); };
+        FulfillPromise(promise, call);
+    });
+    return future;
+}
+
+#if __cplusplus >= 202002L
+// 在协程中 co_await future：挂起协程而不是阻塞线程，结果就绪后在线程池中恢复
+template<typename T>
+auto operator co_await(Future<T>&& future) {
+    struct Awaiter {
+        Future<T> future;
+
+        bool await_ready() const { return future.Ready(); }
+        void await_suspend(std::coroutine_handle<> handle) {
+            ThreadPool* pool = future.Pool();
+            future.OnReady([pool, handle]() {
+                if (pool) {
+                    pool->Post([handle]() { handle.resume(); });
+                } else {
+                    handle.resume();
+                }
+            });
+        }
+        T await_resume() { return future.Get(); }
+    };
+    return Awaiter{std::move(future)};
+}
+#endif
+
+// 有向无环图任务：先用 AddNode/AddEdge 描述节点和依赖，再用 Run 在线程池上执行
+// 每个节点带一个原子依赖计数，前驱全部完成时由最后一个前驱把它投递到线程池，
+// 执行过程中不阻塞任何工作线程。同一个图可以反复运行，节点不会重新分配
+// 运行期间不能修改图，图对象必须存活到 Run 返回的 Future 就绪
+class TaskGraph {
+public:
+    using NodeId = size_t;
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    template<typename F>
+    NodeId AddNode(F&& fn) {
+        CheckIdle();
+        nodes_.push_back(std::make_unique<Node>(InlineTask(std::forward<F>(fn))));
+        validated_ = false;
+        return nodes_.size() - 1;
+    }
+
+    // to 在 from 完成之后才能执行
+    void AddEdge(NodeId from, NodeId to) {
+        CheckIdle();
+        if (from >= nodes_.size() || to >= nodes_.size()) {
+            throw std::out_of_range("TaskGraph node id out of range");
+        }
+        nodes_[from]->successors.push_back(to);
+        nodes_[to]->dependencies++;
+        validated_ = false;
+    }
+
+    size_t Size() const { return nodes_.size(); }
+
+    // 开始执行整个图，所有节点完成后返回的 Future 就绪
+    // 某个节点抛出异常后，尚未开始的节点不再执行，第一个异常通过 Future 传出
+    Future<void> Run(ThreadPool& pool) {
+        CheckIdle();
+        Validate();
+        Promise<void> done(&pool);
+        Future<void> result = done.GetFuture();
+        if (nodes_.empty()) {
+            done.SetValue();
+            return result;
+        }
+        running_.store(true, std::memory_order_relaxed);
+        done_ = std::move(done);
+        pool_ = &pool;
+        failed_.store(false, std::memory_order_relaxed);
+        error_ = nullptr;
+        remaining_.store(nodes_.size(), std::memory_order_relaxed);
+        for (auto& node : nodes_) {
+            node->pending.store(node->dependencies, std::memory_order_relaxed);
+        }
+        for (NodeId id = 0; id < nodes_.size(); ++id) {
+            if (nodes_[id]->dependencies == 0) Schedule(id);
+        }
+        return result;
+    }
+
+private:
+    struct Node {
+        explicit Node(InlineTask fn) : fn(std::move(fn)) {}
+        InlineTask fn;
+        std::vector<NodeId> successors;
+        int dependencies = 0;
+        std::atomic<int> pending{0};
+    };
+
+    void CheckIdle() const {
+        if (running_.load(std::memory_order_acquire)) {
+            throw std::logic_error("TaskGraph is running");
+        }
+    }
+
+    // 用拓扑排序检查是否有环，图没有修改时不重复检查
+    void Validate() {
+        if (validated_) return;
+        std::vector<int> indegree(nodes_.size());
+        std::vector<NodeId> ready;
+        for (NodeId id = 0; id < nodes_.size(); ++id) {
+            indegree[id] = nodes_[id]->dependencies;
+            if (indegree[id] == 0) ready.push_back(id);
+        }
+        size_t visited = 0;
+        while (!ready.empty()) {
+            NodeId id = ready.back();
+            ready.pop_back();
+            ++visited;
+            for (NodeId next : nodes_[id]->successors) {
+                if (--indegree[next] == 0) ready.push_back(next);
+            }
+        }
+        if (visited != nodes_.size()) {
+            throw std::logic_error("TaskGraph contains a cycle");
+        }
+        validated_ = true;
+    }
+
+    void Schedule(NodeId id) {
+        pool_->Post([this, id]() { Execute(id); });
+    }
+
+    void Execute(NodeId id) {
+        Node& node = *nodes_[id];
+        if (!failed_.load(std::memory_order_relaxed)) {
+            try {
+                node.fn();
+            } catch (...) {
+                bool expected = false;
+                if (failed_.compare_exchange_strong(expected, true)) {
+                    error_ = std::current_exception();
+                }
+            }
+        }
+        for (NodeId next : node.successors) {
+            if (nodes_[next]->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                Schedule(next);
+            }
+        }
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            Promise<void> done = std::move(done_);
+            std::exception_ptr error = error_;
+            // 先结束运行状态，等待者被唤醒后可以立即再次运行这个图
+            running_.store(false, std::memory_order_release);
+            if (error) {
+                done.SetException(error);
+            } else {
+                done.SetValue();
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+    bool validated_ = false;
+    std::atomic<bool> running_{false};
+    ThreadPool* pool_ = nullptr;
+    Promise<void> done_;
+    std::atomic<size_t> remaining_{0};
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+};
+
+#endif
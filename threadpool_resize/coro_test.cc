@@ -0,0 +1,79 @@
+// 协程支持的测试，需要使用 C++20 编译
+#include "thread_pool.h"
+#include "async_future.h"
+#include <gtest/gtest.h>
+
+class CoroutineTest : public ::testing::Test {
+ public:
+    void SetUp() override { pool_ = std::make_unique<ThreadPool>(2); }
+    void TearDown() override { pool_->ShutDown(); }
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+int add(int a, int b) { return a + b; }
+
+coro::Task<std::thread::id> ResumeOnWorker(ThreadPool &pool) {
+    co_await pool.Schedule();
+    co_return std::this_thread::get_id();
+}
+
+TEST_F(CoroutineTest, ScheduleResumesOnWorker) {
+    auto id = coro::SyncWait(ResumeOnWorker(*pool_));
+    EXPECT_NE(id, std::this_thread::get_id());
+}
+
+coro::Task<int> AwaitResults(ThreadPool &pool) {
+    co_await pool.Schedule();
+    int a = co_await pool.SubmitAsync(add, 1, 2);
+    int b = co_await coro::Async(pool, []() { return 40; });
+    co_return a + b;
+}
+
+coro::Task<int> Nested(ThreadPool &pool) {
+    int v = co_await AwaitResults(pool);
+    co_return v * 2;
+}
+
+TEST_F(CoroutineTest, AwaitFutureAndNestedTask) {
+    EXPECT_EQ(coro::SyncWait(Nested(*pool_)), 86);
+}
+
+coro::Task<void> Throwing(ThreadPool &pool) {
+    co_await pool.Schedule();
+    co_await pool.SubmitAsync([]() { throw std::runtime_error("boom"); });
+}
+
+TEST_F(CoroutineTest, ExceptionPropagates) {
+    EXPECT_THROW(coro::SyncWait(Throwing(*pool_)), std::runtime_error);
+}
+
+// 几千个协程同时挂起等待各自的 Future，只使用两个工作线程
+coro::Task<void> Waiter(ThreadPool &pool, Future<int> future,
+                        std::atomic<int> &done, int i) {
+    co_await pool.Schedule();
+    int v = co_await std::move(future);
+    if (v == i + 1)
+        done++;
+}
+
+TEST_F(CoroutineTest, ThousandsInFlight) {
+    const int kCount = 5000;
+    std::atomic<int> done(0);
+    std::vector<Promise<int>> promises;
+    promises.reserve(kCount);
+    for (int i = 0; i < kCount; ++i) {
+        promises.emplace_back(pool_.get());
+        coro::Spawn(Waiter(*pool_, promises.back().GetFuture(), done, i));
+    }
+    EXPECT_EQ(done.load(), 0);
+    for (int i = 0; i < kCount; ++i)
+        promises[i].SetValue(i + 1);
+    while (done.load() < kCount)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(done.load(), kCount);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,4 +1,8 @@
 #include "thread_pool.h"
+#include "parallel.h"
+#include "async_future.h"
+#include "sharded_thread_pool.h"
+#include "strand.h"
 #include <gtest/gtest.h>
 
 #if 1
@@ -108,6 +112,514 @@ TEST_F(ThreadPoolTest, ShrinkFunctionality) {
     EXPECT_EQ(future2.get(), 7);
 }
 
+
+// 测试批量提交
+TEST_F(ThreadPoolTest, SubmitBulkAndBatch) {
+    std::vector<int> nums(1000);
+    for (int i = 0; i < 1000; ++i) nums[i] = i;
+    auto futures = pool_->SubmitBulk(nums.begin(), nums.end(),
+                                     [](int v) { return v * 2; });
+    ASSERT_EQ(futures.size(), nums.size());
+    long long sum = 0;
+    for (auto& future : futures) sum += future.get();
+    EXPECT_EQ(sum, 999LL * 1000);
+
+    std::atomic<int> counter(0);
+    std::vector<std::function<void()>> fns(100, [&counter]() { counter++; });
+    auto batch = pool_->SubmitBatch(std::move(fns));
+    for (auto& future : batch) future.get();
+    EXPECT_EQ(counter.load(), 100);
+
+    auto empty = pool_->SubmitBulk(nums.begin(), nums.begin(),
+                                   [](int v) { return v; });
+    EXPECT_TRUE(empty.empty());
+}
+
+// 使用 ParallelFor 的矩阵乘法，不再为每个元素创建 future
+TEST_F(ThreadPoolTest, ParallelForMatrixMultiplication) {
+    std::vector<std::vector<int>> A = {{1, 2, 3}, {4, 5, 6}};
+    std::vector<std::vector<int>> B = {{7, 8}, {9, 10}, {11, 12}};
+    size_t m = A.size(), n = A[0].size(), p = B[0].size();
+    std::vector<std::vector<int>> C(m, std::vector<int>(p, 0));
+    ParallelFor(*pool_, size_t(0), m * p, size_t(0), [&](size_t idx) {
+        size_t i = idx / p, j = idx % p;
+        int sum = 0;
+        for (size_t k = 0; k < n; ++k) sum += A[i][k] * B[k][j];
+        C[i][j] = sum;
+    });
+    std::vector<std::vector<int>> expected = {{58, 64}, {139, 154}};
+    EXPECT_EQ(C, expected);
+
+    std::vector<int> marks(100000, 0);
+    ParallelFor(*pool_, 0, 100000, 0, [&](int i) { marks[i]++; });
+    EXPECT_EQ(std::count(marks.begin(), marks.end(), 1), 100000);
+
+    EXPECT_THROW(ParallelFor(*pool_, 0, 1000, 10, [](int i) {
+                     if (i == 500) throw std::runtime_error("boom");
+                 }),
+                 std::runtime_error);
+}
+
+TEST_F(ThreadPoolTest, ParallelReduceSum) {
+    long long sum = ParallelReduce(
+        *pool_, 1, 100001, 0LL, [](int i) { return static_cast<long long>(i); },
+        [](long long a, long long b) { return a + b; });
+    EXPECT_EQ(sum, 100000LL * 100001 / 2);
+
+    long long fixed = ParallelReduce(
+        *pool_, 0, 10, 5LL, [](int i) { return static_cast<long long>(i); },
+        [](long long a, long long b) { return a + b; }, 3);
+    EXPECT_EQ(fixed, 50);
+}
+
+// 测试线程池指标
+TEST_F(ThreadPoolTest, MetricsSnapshot) {
+    ThreadPool pool(2);
+    // 线程在构造时就计入总数，不需要等它们开始运行
+    EXPECT_EQ(pool.GetStatus().total_threads, 2);
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 20; ++i) {
+        futures.push_back(pool.Submit([i]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return i;
+        }));
+    }
+    for (auto& future : futures) future.get();
+
+    auto status = pool.GetStatus();
+    EXPECT_EQ(status.total_threads, 2);
+    EXPECT_EQ(status.queue_size, 0);
+
+    // future 就绪时任务的计时可能还没写入，等工作线程退出后再取快照
+    pool.ShutDown();
+    PoolMetrics metrics = pool.GetMetrics();
+    EXPECT_EQ(metrics.workers.size(), 2u);
+    EXPECT_EQ(metrics.tasks_executed, 20u);
+    EXPECT_EQ(metrics.run_time.total, 20u);
+    EXPECT_EQ(metrics.queue_wait.total, 20u);
+    // 每个任务至少睡眠 1ms
+    EXPECT_GE(metrics.run_time.Percentile(0.5), 1000000u);
+    EXPECT_GE(metrics.busy_ns, 20u * 1000000u);
+    EXPECT_GT(metrics.Utilization(), 0.0);
+}
+
+// 测试延迟任务和周期任务
+TEST_F(ThreadPoolTest, DelayedAndPeriodicTasks) {
+    auto start = std::chrono::steady_clock::now();
+    auto later = pool_->SubmitAfter(std::chrono::milliseconds(30), add, 1, 2);
+    auto sooner = pool_->SubmitAt(start + std::chrono::milliseconds(10),
+                                  []() { return std::chrono::steady_clock::now(); });
+    EXPECT_GE(sooner.get() - start, std::chrono::milliseconds(10));
+    EXPECT_EQ(later.get(), 3);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(30));
+
+    std::atomic<int> ticks(0);
+    TimerHandle handle = pool_->SubmitEvery(std::chrono::milliseconds(5),
+                                            [&ticks]() { ticks++; });
+    while (ticks.load() < 3) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    handle.Cancel();
+    EXPECT_TRUE(handle.Cancelled());
+    // 取消时可能已经有一次执行投递到了线程池
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int after_cancel = ticks.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(ticks.load(), after_cancel);
+}
+
+// 周期任务抛出异常时定时器继续运行，异常被计数，不会终止工作线程
+TEST_F(ThreadPoolTest, PeriodicTaskThrows) {
+    std::atomic<int> ticks(0);
+    TimerHandle handle = pool_->SubmitEvery(std::chrono::milliseconds(5), [&ticks]() {
+        ticks++;
+        throw std::runtime_error("periodic failure");
+    });
+    while (ticks.load() < 3) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    handle.Cancel();
+    // 等待已经投递的那一次执行结束
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_GE(handle.Failures(), 3u);
+    EXPECT_EQ(handle.Failures(), static_cast<uint64_t>(ticks.load()));
+}
+
+// 大量定时器，跨越时间轮的多个层级，并取消其中一半
+TEST(TimerWheelTest, ManyTimersWithCancel) {
+    std::atomic<int> fired(0);
+    auto wheel = std::make_shared<TimerWheel>([](InlineTask&& task) {
+        task();
+    });
+    const int kTimers = 200000;
+    std::vector<std::shared_ptr<TimerNode>> nodes;
+    nodes.reserve(kTimers);
+    auto base = TimerWheel::Clock::now() + std::chrono::milliseconds(100);
+    // 取消成功的定时器不会执行，其余的在到期后执行
+    int cancelled = 0;
+    for (int i = 0; i < kTimers; ++i) {
+        nodes.push_back(wheel->Schedule(base + std::chrono::milliseconds(i % 400),
+                                        TimerWheel::Clock::duration::zero(),
+                                        InlineTask([&fired]() { fired++; })));
+        if (i % 2 == 1 && TimerHandle(nodes[i - 1]).Cancel()) cancelled++;
+    }
+    while (wheel->Pending() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    wheel->Stop();
+    EXPECT_GT(cancelled, 0);
+    EXPECT_EQ(fired.load() + cancelled, kTimers);
+}
+
+// 测试后续任务，以及 WhenAll/WhenAny 组合
+TEST_F(ThreadPoolTest, FutureContinuations) {
+    auto chained = pool_->SubmitAsync(add, 1, 2)
+                       .Then([](int v) { return v * 10; })
+                       .Then([](int v) { return std::to_string(v); });
+    EXPECT_EQ(chained.Get(), "30");
+
+    // 异常跳过后续任务，传递到最后一个 Future
+    std::atomic<bool> skipped(true);
+    auto failed = pool_->SubmitAsync([]() -> int { throw std::runtime_error("boom"); })
+                      .Then([&skipped](int v) { skipped = false; return v; });
+    EXPECT_THROW(failed.Get(), std::runtime_error);
+    EXPECT_TRUE(skipped.load());
+
+    std::vector<Future<int>> futures;
+    for (int i = 0; i < 50; ++i) futures.push_back(pool_->SubmitAsync(add, i, 1));
+    auto all = WhenAll(std::move(futures)).Then([](std::vector<Future<int>> done) {
+        int sum = 0;
+        for (auto& f : done) sum += f.Get();
+        return sum;
+    });
+    EXPECT_EQ(all.Get(), 50 * 49 / 2 + 50);
+
+    std::vector<Future<void>> racers;
+    racers.push_back(pool_->SubmitAsync([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }));
+    racers.push_back(pool_->SubmitAsync([]() {}));
+    auto any = WhenAny(std::move(racers)).Get();
+    EXPECT_EQ(any.index, 1u);
+    EXPECT_EQ(any.futures.size(), 2u);
+    any.futures[0].Get();
+}
+
+// 菱形依赖的任务图，同一个图运行多次
+TEST_F(ThreadPoolTest, TaskGraphDiamond) {
+    std::atomic<int> step(0);
+    int a = 0, b = 0, c = 0, d = 0;
+    TaskGraph graph;
+    auto na = graph.AddNode([&]() { a = ++step; });
+    auto nb = graph.AddNode([&]() { b = ++step; });
+    auto nc = graph.AddNode([&]() { c = ++step; });
+    auto nd = graph.AddNode([&]() { d = ++step; });
+    graph.AddEdge(na, nb);
+    graph.AddEdge(na, nc);
+    graph.AddEdge(nb, nd);
+    graph.AddEdge(nc, nd);
+    for (int run = 0; run < 3; ++run) {
+        step = 0;
+        graph.Run(*pool_).Get();
+        EXPECT_EQ(a, 1);
+        EXPECT_LT(a, b);
+        EXPECT_LT(a, c);
+        EXPECT_EQ(d, 4);
+    }
+
+    graph.AddEdge(nd, na);
+    EXPECT_THROW(graph.Run(*pool_), std::logic_error);
+
+    TaskGraph failing;
+    bool ran_after = false;
+    auto first = failing.AddNode([]() { throw std::runtime_error("node failed"); });
+    auto second = failing.AddNode([&ran_after]() { ran_after = true; });
+    failing.AddEdge(first, second);
+    EXPECT_THROW(failing.Run(*pool_).Get(), std::runtime_error);
+    EXPECT_FALSE(ran_after);
+}
+
+// 递归分治：工作线程等待子任务时先执行队列中的任务，两个线程也不会死锁
+int ParallelFib(ThreadPool& pool, int n) {
+    if (n < 12) {
+        int a = 0, b = 1;
+        for (int i = 0; i < n; ++i) {
+            int next = a + b;
+            a = b;
+            b = next;
+        }
+        return a;
+    }
+    std::future<int> left = pool.Submit([&pool, n]() { return ParallelFib(pool, n - 1); });
+    int right = ParallelFib(pool, n - 2);
+    return pool.Get(left) + right;
+}
+
+// 同上，子任务用 SubmitAsync 提交，等待 Future
+int ParallelFibAsync(ThreadPool& pool, int n) {
+    if (n < 12) return ParallelFib(pool, n);
+    Future<int> left = pool.SubmitAsync([&pool, n]() { return ParallelFibAsync(pool, n - 1); });
+    int right = ParallelFibAsync(pool, n - 2);
+    return pool.Get(left) + right;
+}
+
+TEST(HelpWhileWaitingTest, NestedWaitsDoNotDeadlock) {
+    ThreadPool pool(2);
+    auto root = pool.Submit([&pool]() { return ParallelFib(pool, 24); });
+    EXPECT_EQ(pool.Get(root), 46368);
+    EXPECT_EQ(pool.GetStatus().total_threads, 2);
+    pool.ShutDown();
+}
+
+TEST(HelpWhileWaitingTest, NestedAsyncWaitsDoNotDeadlock) {
+    ThreadPool pool(2);
+    Future<int> root = pool.SubmitAsync([&pool]() { return ParallelFibAsync(pool, 24); });
+    EXPECT_EQ(pool.Get(root), 46368);
+    EXPECT_EQ(pool.GetStatus().total_threads, 2);
+    pool.ShutDown();
+}
+
+// 一个计数器等待整组任务，嵌套等待不会占住唯一的工作线程，第一个异常传递给 Wait
+TEST_F(ThreadPoolTest, TaskGroupForkJoin) {
+    std::vector<std::vector<int>> A = {{1, 2, 3}, {4, 5, 6}};
+    std::vector<std::vector<int>> B = {{7, 8}, {9, 10}, {11, 12}};
+    std::vector<std::vector<int>> C(2, std::vector<int>(2, 0));
+    TaskGroup group(*pool_);
+    for (size_t i = 0; i < 2; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            group.Run([i, j, &A, &B, &C]() {
+                for (size_t k = 0; k < 3; ++k) C[i][j] += A[i][k] * B[k][j];
+            });
+        }
+    }
+    group.Wait();
+    EXPECT_EQ(C, (std::vector<std::vector<int>>{{58, 64}, {139, 154}}));
+
+    ThreadPool single(1);
+    std::atomic<int> leaves(0);
+    TaskGroup outer(single);
+    for (int i = 0; i < 4; ++i) {
+        outer.Run([&single, &leaves]() {
+            TaskGroup inner(single);
+            for (int j = 0; j < 8; ++j) inner.Run([&leaves]() { leaves++; });
+            inner.Wait();
+        });
+    }
+    outer.Wait();
+    EXPECT_EQ(leaves.load(), 32);
+
+    std::atomic<int> ran(0);
+    for (int i = 0; i < 100; ++i) {
+        group.Run([i, &ran]() {
+            ran++;
+            if (i == 10) throw std::runtime_error("task failed");
+        });
+    }
+    EXPECT_THROW(group.Wait(), std::runtime_error);
+    EXPECT_LE(ran.load(), 100);
+
+    // Wait 之后同一个组可以继续使用，之前的异常不会再次抛出
+    group.Run([&ran]() { ran = -1; });
+    group.Wait();
+    EXPECT_EQ(ran.load(), -1);
+    single.ShutDown();
+}
+
+// 多个提交者并发提交到分片队列，任务都被执行，关闭时队列中的任务全部完成
+TEST(ShardedThreadPoolTest, ConcurrentProducers) {
+    ShardedThreadPool pool(4, 2);
+    EXPECT_EQ(pool.ShardCount(), 2);
+    EXPECT_EQ(ShardedThreadPool(2, 8).ShardCount(), 2);
+
+    const int kProducers = 4;
+    const int kTasks = 5000;
+    std::atomic<long> sum(0);
+    std::vector<std::thread> producers;
+    std::vector<std::vector<std::future<int>>> futures(kProducers);
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < kTasks; ++i) {
+                if (i % 2) {
+                    futures[p].push_back(pool.Submit([](int a, int b) { return a + b; }, i, p));
+                } else {
+                    pool.Post([&sum, i]() { sum += i; });
+                }
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    for (int p = 0; p < kProducers; ++p) {
+        for (int i = 0; i < kTasks / 2; ++i) {
+            EXPECT_EQ(futures[p][i].get(), 2 * i + 1 + p);
+        }
+    }
+
+    // 工作线程内部继续提交，关闭时等待所有排队的任务
+    std::atomic<int> nested(0);
+    for (int i = 0; i < 100; ++i) {
+        pool.Post([&pool, &nested]() {
+            for (int j = 0; j < 10; ++j) pool.Post([&nested]() { nested++; });
+        });
+    }
+    pool.ShutDown();
+    EXPECT_EQ(nested.load(), 1000);
+    EXPECT_EQ(sum.load(), kProducers * (long)(kTasks / 2) * (kTasks / 2 - 1));
+    EXPECT_EQ(pool.GetStatus().queue_size, 0);
+}
+
+// 取消父节点时子孙节点一并取消，排队中的任务被丢弃，执行中的任务自行检查 token
+TEST(CancellationTest, CancelQueuedAndRunningTasks) {
+    CancellationSource parent;
+    CancellationSource child(parent.Token());
+    CancellationSource grandchild(child.Token());
+    CancellationSource other;
+    parent.Cancel();
+    EXPECT_TRUE(child.IsCancelled());
+    EXPECT_TRUE(grandchild.Token().IsCancelled());
+    EXPECT_FALSE(other.IsCancelled());
+    EXPECT_TRUE(CancellationSource(parent.Token()).IsCancelled());
+    EXPECT_FALSE(CancellationToken().IsCancelled());
+
+    // 单线程的池被一个任务占住，其余任务都在排队
+    ThreadPool pool(1);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    CancellationSource request;
+    CancellationSource sub(request.Token());
+    std::atomic<bool> started(false);
+    auto running = pool.Submit(request.Token(), [&started, opened, token = request.Token()]() {
+        started = true;
+        opened.wait();
+        int polls = 0;
+        while (!token.IsCancelled()) ++polls;
+        return polls >= 0;
+    });
+    while (!started) std::this_thread::yield();
+
+    std::atomic<int> ran(0);
+    std::vector<std::future<int>> queued;
+    for (int i = 0; i < 10; ++i) {
+        const CancellationToken& token = i % 2 ? sub.Token() : request.Token();
+        queued.push_back(pool.Submit(token, [&ran](int v) { ran++; return v; }, i));
+    }
+    auto unrelated = pool.Submit(other.Token(), add, 1, 2);
+    auto async = pool.SubmitAsync(sub.Token(), [&ran]() { ran++; });
+
+    request.Cancel();
+    gate.set_value();
+    EXPECT_TRUE(running.get());
+    for (auto& f : queued) EXPECT_THROW(f.get(), TaskCancelled);
+    EXPECT_THROW(async.Get(), TaskCancelled);
+    EXPECT_EQ(unrelated.get(), 3);
+    EXPECT_EQ(ran.load(), 0);
+
+    // 提交时已经取消的任务不进入队列
+    EXPECT_THROW(pool.Submit(request.Token(), add, 1, 1).get(), TaskCancelled);
+    pool.ShutDown();
+}
+
+TEST(StrandTest, PerKeyOrderAcrossProducers) {
+    ThreadPool pool(4);
+    KeyedExecutor<int> executor(pool, 8);
+    const int kKeys = 1000;
+    const int kProducers = 4;
+    const int kPerProducer = 50;
+    // 每个 key 记录各个提交者上一次执行到的序号，以及是否有任务在并发执行
+    struct KeyState {
+        int last[kProducers];
+        std::atomic<bool> busy{false};
+        int count = 0;
+    };
+    std::vector<KeyState> states(kKeys);
+    for (auto& s : states) std::fill(std::begin(s.last), std::end(s.last), -1);
+    std::atomic<int> errors(0);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            for (int seq = 0; seq < kPerProducer; ++seq) {
+                for (int key = 0; key < kKeys; ++key) {
+                    executor.Post(key, [&states, &errors, key, p, seq]() {
+                        KeyState& s = states[key];
+                        if (s.busy.exchange(true)) errors++;
+                        if (s.last[p] != seq - 1) errors++;
+                        s.last[p] = seq;
+                        s.count++;
+                        s.busy.store(false);
+                    });
+                }
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    // 每个 key 的最后一个任务返回时，这个 key 之前的任务都已经执行完
+    std::vector<std::future<int>> done;
+    for (int key = 0; key < kKeys; ++key) {
+        done.push_back(executor.Submit(key, [&states, key]() { return states[key].count; }));
+    }
+    for (auto& f : done) EXPECT_EQ(f.get(), kProducers * kPerProducer);
+    EXPECT_EQ(errors.load(), 0);
+    EXPECT_EQ(executor.Size(), static_cast<size_t>(kKeys));
+    pool.ShutDown();
+}
+
+TEST(StrandTest, BatchLimitYieldsToOtherTasks) {
+    ThreadPool pool(1);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    pool.Post([opened]() { opened.wait(); });
+
+    // 工作线程被占住时提交，strand 的 20 个任务排在一个普通任务之前
+    Strand<> strand(pool, 4);
+    std::vector<int> order;
+    for (int i = 0; i < 20; ++i) {
+        strand.Post([&order, &strand, i]() {
+            EXPECT_TRUE(strand.RunningInThisThread());
+            order.push_back(i);
+        });
+    }
+    auto other = pool.Submit([&order]() { order.push_back(-1); });
+    EXPECT_FALSE(strand.RunningInThisThread());
+    gate.set_value();
+    other.get();
+    strand.Submit([]() {}).get();
+
+    // 执行完第一批 4 个任务后 strand 重新排队，普通任务插在中间
+    std::vector<int> expected{0, 1, 2, 3, -1};
+    for (int i = 4; i < 20; ++i) expected.push_back(i);
+    EXPECT_EQ(order, expected);
+    // 计数在一批任务全部返回后才减少，等工作线程退出后再检查
+    pool.ShutDown();
+    EXPECT_EQ(strand.Pending(), 0u);
+}
+
+TEST(StrandTest, TrimDropsIdleStrands) {
+    ThreadPool pool(2);
+    KeyedExecutor<std::string> executor(pool);
+    Strand<> held = executor.StrandFor("held");
+    std::vector<std::future<void>> done;
+    for (int i = 0; i < 100; ++i) {
+        done.push_back(executor.Submit("key" + std::to_string(i), []() {}));
+    }
+    for (auto& f : done) f.get();
+    // future 就绪时 strand 的计数可能还没减少，等所有 strand 都收尾后再清理
+    for (int i = 0; i < 100; ++i) {
+        Strand<> strand = executor.StrandFor("key" + std::to_string(i));
+        while (strand.Pending() != 0) std::this_thread::yield();
+    }
+    EXPECT_EQ(executor.Size(), 101u);
+    // 调用者还持有的 strand 不会被删除，其余都已经空闲
+    EXPECT_EQ(executor.Trim(), 100u);
+    EXPECT_EQ(executor.Size(), 1u);
+    EXPECT_EQ(executor.Submit("key1", [](int v) { return v * 2; }, 21).get(), 42);
+    pool.ShutDown();
+}
+
+TEST(LatencyHistogramTest, BucketBounds) {
+    for (uint64_t v : {0ull, 3ull, 4ull, 9ull, 1000ull, 123456789ull}) {
+        int idx = LatencyHistogram::Index(v);
+        EXPECT_LE(v, LatencyHistogram::UpperBound(idx));
+        if (idx > 0) {
+            EXPECT_GT(v, LatencyHistogram::UpperBound(idx - 1));
+        }
+    }
+}
 #endif
 
 #if 1
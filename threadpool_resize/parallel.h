@@ -0,0 +1,191 @@
+#ifndef __PARALLEL__
+#define __PARALLEL__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "task_group.h"
+#include "thread_pool.h"
+
+// 一次性倒计数器，计数减到0后所有等待者返回
+class Latch {
+public:
+    explicit Latch(int count) : count_(count) {}
+
+    void CountDown(int n = 1) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        count_ -= n;
+        if (count_ <= 0) {
+            cond_.notify_all();
+        }
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait(lock, [this]() { return count_ <= 0; });
+    }
+
+private:
+    int count_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+};
+
+// ParallelFor/ParallelReduce 的共享状态
+// 由调用线程和线程池中的辅助任务共同持有，
+// 辅助任务可能在调用线程返回后才开始执行，因此不能放在调用线程的栈上
+template<typename Index>
+struct ParallelRange {
+    ParallelRange(Index begin, Index end, Index grain, int participants)
+        : next(begin), end(end), grain(grain),
+          participants(participants), remaining(end - begin), done(1) {}
+
+    // 领取下一段区间 [lo, hi)
+    // 指定了 grain 时按固定大小切分；否则按剩余量的 1/(2*参与者数) 切分，
+    // 开始时块较大以减少争用，接近结束时块变小以平衡负载
+    bool Claim(Index& lo, Index& hi) {
+        lo = next.load(std::memory_order_relaxed);
+        while (true) {
+            if (lo >= end) return false;
+            Index left = end - lo;
+            Index chunk = grain;
+            if (chunk <= 0) {
+                chunk = std::max<Index>(
+                    1, left / static_cast<Index>(2 * participants));
+            }
+            hi = lo + std::min(chunk, left);
+            if (next.compare_exchange_weak(lo, hi, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+    // 处理已经领取的 [lo, hi)，然后继续领取直到区间耗尽
+    // body(lo, hi) 抛出的第一个异常被记录下来，之后的区间直接跳过
+    template<typename Body>
+    void Process(Index lo, Index hi, Body& body) {
+        do {
+            if (!failed.load(std::memory_order_relaxed)) {
+                try {
+                    body(lo, hi);
+                } catch (...) {
+                    Fail();
+                }
+            }
+            Finish(hi - lo);
+        } while (Claim(lo, hi));
+    }
+
+    // 完成了一段区间，全部完成后释放调用线程
+    void Finish(Index count) {
+        if (remaining.fetch_sub(count, std::memory_order_acq_rel) == count) {
+            done.CountDown();
+        }
+    }
+
+    void Fail() {
+        bool expected = false;
+        if (failed.compare_exchange_strong(expected, true)) {
+            error = std::current_exception();
+        }
+    }
+
+    std::atomic<Index> next;
+    Index end;
+    Index grain;
+    int participants;
+    std::atomic<Index> remaining;
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    Latch done;
+};
+
+// 辅助线程数：不超过线程池大小，也不超过区间能切出的块数
+template<typename Index>
+int ParallelHelpers(ThreadPool& pool, Index count, Index grain) {
+    int threads = std::max(pool.GetStatus().total_threads, 0);
+    Index chunks = grain > 0 ? (count + grain - 1) / grain : count;
+    return static_cast<int>(
+        std::min<Index>(static_cast<Index>(threads), chunks - 1));
+}
+
+// 对 [begin, end) 中的每个下标并行调用 fn(i)
+// grain <= 0 时自动选择块大小；调用线程同样参与计算，
+// 只使用一个完成计数器等待，不为每个元素创建 future
+// fn 抛出的第一个异常会在所有已领取的区间结束后重新抛出
+template<typename Index, typename F>
+void ParallelFor(ThreadPool& pool, Index begin, Index end, Index grain, F&& fn) {
+    if (begin >= end) return;
+    int helpers = ParallelHelpers(pool, end - begin, grain);
+    auto state = std::make_shared<ParallelRange<Index>>(begin, end, grain,
+                                                        helpers + 1);
+    auto* func = &fn;
+    auto body = [func](Index lo, Index hi) {
+        for (Index i = lo; i < hi; ++i) (*func)(i);
+    };
+    for (int i = 0; i < helpers; ++i) {
+        pool.Post([state, body]() mutable {
+            Index lo, hi;
+            // 区间已经全部领取完时调用线程可能已经返回，不能再访问 fn
+            if (state->Claim(lo, hi)) state->Process(lo, hi, body);
+        });
+    }
+    Index lo, hi;
+    if (state->Claim(lo, hi)) state->Process(lo, hi, body);
+    state->done.Wait();
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+// 并行归约：result = combine(init, map(begin), ..., map(end - 1))
+// 每个参与者先在本地累加，最后由调用线程合并，combine 需满足结合律和交换律
+template<typename Index, typename T, typename Map, typename Combine>
+T ParallelReduce(ThreadPool& pool, Index begin, Index end, T init, Map&& map,
+                 Combine&& combine, Index grain = 0) {
+    if (begin >= end) return init;
+    int helpers = ParallelHelpers(pool, end - begin, grain);
+    auto state = std::make_shared<ParallelRange<Index>>(begin, end, grain,
+                                                        helpers + 1);
+    // 每个参与者一个局部结果槽，调用线程使用 0 号
+    std::vector<std::optional<T>> partials(helpers + 1);
+
+    auto* map_fn = &map;
+    auto* combine_fn = &combine;
+    auto accumulate = [map_fn, combine_fn](std::optional<T>& partial,
+                                           Index lo, Index hi) {
+        for (Index i = lo; i < hi; ++i) {
+            if (partial) {
+                partial = (*combine_fn)(std::move(*partial), (*map_fn)(i));
+            } else {
+                partial.emplace((*map_fn)(i));
+            }
+        }
+    };
+    std::optional<T>* slots = partials.data();
+    for (int i = 1; i <= helpers; ++i) {
+        pool.Post([state, accumulate, slots, i]() {
+            Index lo, hi;
+            if (!state->Claim(lo, hi)) return;
+            auto body = [&](Index l, Index h) { accumulate(slots[i], l, h); };
+            state->Process(lo, hi, body);
+        });
+    }
+    auto body = [&](Index l, Index h) { accumulate(partials[0], l, h); };
+    Index lo, hi;
+    if (state->Claim(lo, hi)) state->Process(lo, hi, body);
+    state->done.Wait();
+    if (state->error) std::rethrow_exception(state->error);
+
+    T result = std::move(init);
+    for (auto& partial : partials) {
+        if (partial) result = (*combine_fn)(std::move(result), std::move(*partial));
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef __POOL_METRICS__
+#define __POOL_METRICS__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// 单调时钟的纳秒时间戳
+inline uint64_t NowNanos() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// 直方图快照，可以求分位数
+struct HistogramSnapshot {
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+
+    // 返回分位数 p（0~1）所在桶的上界，单位纳秒
+    uint64_t Percentile(double p) const;
+    void Merge(const HistogramSnapshot& other);
+};
+
+// HDR 风格的对数直方图：按 2 的幂分段，每段再均分为 4 个子桶，相对误差不超过 25%
+// 每个直方图只由一个工作线程写入，写入只是一次 relaxed 读和写，不需要原子加
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 2;
+    static constexpr int kBuckets = (64 - kSubBits + 1) << kSubBits;
+
+    LatencyHistogram() {
+        for (auto& count : counts_) count.store(0, std::memory_order_relaxed);
+    }
+
+    void Record(uint64_t ns) {
+        auto& count = counts_[Index(ns)];
+        count.store(count.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
+
+    void Snapshot(HistogramSnapshot& out) const {
+        out.counts.resize(kBuckets, 0);
+        for (int i = 0; i < kBuckets; ++i) {
+            uint64_t c = counts_[i].load(std::memory_order_relaxed);
+            out.counts[i] += c;
+            out.total += c;
+        }
+    }
+
+    static int Index(uint64_t v) {
+        if (v < (1u << kSubBits)) return static_cast<int>(v);
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - kSubBits;
+        int sub = static_cast<int>((v >> shift) & ((1u << kSubBits) - 1));
+        return ((shift + 1) << kSubBits) + sub;
+    }
+
+    // 桶 i 能表示的最大值
+    static uint64_t UpperBound(int i) {
+        if (i < (1 << kSubBits)) return static_cast<uint64_t>(i);
+        int shift = (i >> kSubBits) - 1;
+        uint64_t sub = static_cast<uint64_t>(i & ((1 << kSubBits) - 1));
+        uint64_t base = (uint64_t(1) << kSubBits) | sub;
+        return ((base + 1) << shift) - 1;
+    }
+
+private:
+    std::atomic<uint64_t> counts_[kBuckets];
+};
+
+inline uint64_t HistogramSnapshot::Percentile(double p) const {
+    if (total == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) return LatencyHistogram::UpperBound(static_cast<int>(i));
+    }
+    return LatencyHistogram::UpperBound(static_cast<int>(counts.size()) - 1);
+}
+
+inline void HistogramSnapshot::Merge(const HistogramSnapshot& other) {
+    if (counts.size() < other.counts.size()) counts.resize(other.counts.size(), 0);
+    for (size_t i = 0; i < other.counts.size(); ++i) counts[i] += other.counts[i];
+    total += other.total;
+}
+
+// 单个工作线程的计数器，独占缓存行，只由所属线程写入
+struct alignas(64) WorkerMetrics {
+    std::atomic<uint64_t> tasks_executed{0};
+    std::atomic<uint64_t> busy_ns{0};
+    std::atomic<uint64_t> idle_ns{0};
+    std::atomic<uint64_t> wakeups{0};
+    std::atomic<bool> alive{true};
+    LatencyHistogram queue_wait;   // 任务从入队到开始执行的时间
+    LatencyHistogram run_time;     // 任务执行时间
+    WorkerMetrics* next = nullptr; // 线程池内所有工作线程计数器组成的链表
+
+    static void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+};
+
+// 线程池指标快照
+struct PoolMetrics {
+    struct Worker {
+        uint64_t tasks_executed;
+        uint64_t busy_ns;
+        uint64_t idle_ns;
+        uint64_t wakeups;
+        bool alive;
+    };
+    std::vector<Worker> workers;   // 包括已经因缩容退出的线程
+    uint64_t tasks_executed = 0;
+    uint64_t busy_ns = 0;
+    uint64_t idle_ns = 0;
+    uint64_t wakeups = 0;
+    int queue_size = 0;
+    HistogramSnapshot queue_wait;
+    HistogramSnapshot run_time;
+
+    // 工作线程忙碌时间占比
+    double Utilization() const {
+        uint64_t total = busy_ns + idle_ns;
+        return total == 0 ? 0.0 : static_cast<double>(busy_ns) / total;
+    }
+};
+
+// 所有工作线程计数器的注册表，只增不删，线程池析构时统一释放
+// 注册使用 CAS 头插，快照时无锁遍历链表，不会阻塞工作线程
+class MetricsRegistry {
+public:
+    MetricsRegistry() = default;
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    ~MetricsRegistry() {
+        WorkerMetrics* node = head_.load(std::memory_order_acquire);
+        while (node) {
+            WorkerMetrics* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    WorkerMetrics* Register() {
+        WorkerMetrics* node = new WorkerMetrics();
+        node->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(node->next, node,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        return node;
+    }
+
+    void Collect(PoolMetrics& out) const {
+        for (WorkerMetrics* node = head_.load(std::memory_order_acquire); node;
+             node = node->next) {
+            PoolMetrics::Worker w{
+                node->tasks_executed.load(std::memory_order_relaxed),
+                node->busy_ns.load(std::memory_order_relaxed),
+                node->idle_ns.load(std::memory_order_relaxed),
+                node->wakeups.load(std::memory_order_relaxed),
+                node->alive.load(std::memory_order_relaxed)};
+            out.workers.push_back(w);
+            out.tasks_executed += w.tasks_executed;
+            out.busy_ns += w.busy_ns;
+            out.idle_ns += w.idle_ns;
+            out.wakeups += w.wakeups;
+            node->queue_wait.Snapshot(out.queue_wait);
+            node->run_time.Snapshot(out.run_time);
+        }
+    }
+
+private:
+    std::atomic<WorkerMetrics*> head_{nullptr};
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef __SHARDED_THREADPOOL__
+#define __SHARDED_THREADPOOL__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "inline_task.h"
+
+// 分片队列的线程池：任务队列拆成 K 个分片，每个分片有自己的锁和条件变量
+// 提交者随机选两个分片，放入较短的一个（power of two choices），
+// 多个提交者很少争用同一把锁，提交吞吐随分片数增长
+// 工作线程先处理自己所属的分片，为空时再依次查看其他分片
+// 与 ThreadPool 的提交接口相同，但线程数在构造时确定
+class ShardedThreadPool {
+public:
+    // shards <= 0 时每个线程一个分片；分片数不超过线程数，保证每个分片都有所属的线程
+    explicit ShardedThreadPool(int size = std::thread::hardware_concurrency(),
+                               int shards = 0)
+        : pool_size_(std::max(size, 1)),
+          idle_threads_(0),
+          queued_(0),
+          is_stop_(false) {
+        int count = shards <= 0 ? pool_size_ : std::min(shards, pool_size_);
+        for (int i = 0; i < count; ++i) {
+            shards_.emplace_back(new Shard());
+        }
+        for (int i = 0; i < pool_size_; ++i) {
+            threads_.emplace_back([this, i]() {
+                worker(i % static_cast<int>(shards_.size()));
+            });
+        }
+    }
+
+    ~ShardedThreadPool() {
+        ShutDown();
+    }
+
+    // 停止接收唤醒并等待所有已提交的任务执行完毕
+    void ShutDown() {
+        is_stop_.store(true);
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mtx);
+            shard->not_empty.notify_all();
+        }
+        for (auto& thread : threads_) {
+            if (thread.joinable())
+                thread.join();
+        }
+    }
+
+    template<typename F, typename... Args>
+    auto Submit(F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
+        using ret_type = decltype(f(args...));
+        std::promise<ret_type> promise = MakePooledPromise<ret_type>();
+        std::future<ret_type> func_future = promise.get_future();
+        Enqueue(MakePromiseTask(std::move(promise), std::forward<F>(f),
+                                std::forward<Args>(args)...));
+        return func_future;
+    }
+
+    // 提交不关心返回值的任务，不创建 promise/future
+    template<typename F>
+    void Post(F&& f) {
+        Enqueue(Task(std::forward<F>(f)));
+    }
+
+    int ShardCount() const {
+        return static_cast<int>(shards_.size());
+    }
+
+    // 与 ThreadPool::PoolStatus 相同，只读取原子计数，不加锁
+    struct PoolStatus {
+        int total_threads;
+        int idle_threads;
+        int queue_size;
+    };
+
+    PoolStatus GetStatus() const {
+        return {
+            pool_size_,
+            idle_threads_.load(std::memory_order_relaxed),
+            static_cast<int>(queued_.load(std::memory_order_relaxed))
+        };
+    }
+
+private:
+    using Task = InlineTask;
+
+    // 每个分片独占缓存行，不同分片的锁不会伪共享
+    struct alignas(64) Shard {
+        std::mutex mtx;
+        std::condition_variable not_empty;
+        TaskQueue tasks;
+        std::atomic<int> size{0};      // 不加锁地比较负载和跳过空分片
+        std::atomic<int> sleepers{0};  // 睡眠在本分片上且还没有被 Wake 认领的线程数，只在锁内修改
+        int claimed = 0;               // Wake 已经认领、被唤醒的线程还没有确认的次数
+    };
+
+    // 提交者线程本地的随机数，选择分片时不需要共享状态
+    static uint32_t NextRandom() {
+        static thread_local uint32_t seed = static_cast<uint32_t>(
+            std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    // 随机选两个分片，取较短的一个
+    Shard& PickShard() {
+        size_t count = shards_.size();
+        if (count == 1) return *shards_[0];
+        uint32_t r = NextRandom();
+        Shard& a = *shards_[r % count];
+        Shard& b = *shards_[(r >> 16) % count];
+        return a.size.load(std::memory_order_relaxed) <= b.size.load(std::memory_order_relaxed)
+            ? a : b;
+    }
+
+    void Enqueue(Task&& task) {
+        Shard& shard = PickShard();
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            shard.tasks.push(std::move(task));
+            shard.size.fetch_add(1, std::memory_order_relaxed);
+            // 在锁内计数，任务被取走之前计数一定已经增加，总数不会变为负数
+            // 与工作线程睡眠前的检查配对：要么它看到任务计数，要么 Wake 看到它在睡眠
+            queued_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        Wake(shard);
+    }
+
+    // 优先唤醒任务所在分片的线程，那里没有睡眠的线程时唤醒任意一个分片上的线程
+    void Wake(Shard& preferred) {
+        if (TryWake(preferred)) return;
+        for (auto& shard : shards_) {
+            if (shard.get() != &preferred && TryWake(*shard)) return;
+        }
+    }
+
+    // 在通知时就认领一个睡眠者，sleepers 立即减少，连续提交时后面的 Wake 会去唤醒其他线程，
+    // 而不是反复通知同一个还没来得及醒来的线程
+    bool TryWake(Shard& shard) {
+        if (shard.sleepers.load(std::memory_order_seq_cst) == 0) return false;
+        {
+            // 加锁保证睡眠者要么已经进入等待，要么能看到新的任务计数
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            if (shard.sleepers.load(std::memory_order_relaxed) == 0) return false;
+            shard.sleepers.fetch_sub(1, std::memory_order_relaxed);
+            shard.claimed++;
+        }
+        shard.not_empty.notify_one();
+        return true;
+    }
+
+    bool PopShard(Shard& shard, Task& task) {
+        if (shard.size.load(std::memory_order_relaxed) == 0) return false;
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        if (shard.tasks.empty()) return false;
+        task = std::move(shard.tasks.front());
+        shard.tasks.pop();
+        shard.size.fetch_sub(1, std::memory_order_relaxed);
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 先取所属分片，再从下一个分片开始依次查看其他分片
+    bool FindTask(int home, Task& task) {
+        int count = static_cast<int>(shards_.size());
+        for (int i = 0; i < count; ++i) {
+            if (PopShard(*shards_[(home + i) % count], task)) return true;
+        }
+        return false;
+    }
+
+    void worker(int home) {
+        Shard& shard = *shards_[home];
+        while (true) {
+            Task task;
+            if (FindTask(home, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(shard.mtx);
+            idle_threads_++;
+            shard.sleepers.fetch_add(1, std::memory_order_seq_cst);
+            // 任意分片中还有任务就不睡眠，停止后把剩余任务执行完再退出
+            auto ready = [this]() {
+                return is_stop_.load() || queued_.load(std::memory_order_seq_cst) > 0;
+            };
+            while (!ready()) {
+                shard.not_empty.wait(lock);
+                // 醒来的线程可能还要继续睡眠，先确认一次认领并重新计入 sleepers，
+                // 否则它会在没有被计数的情况下睡眠，之后的 Wake 看不到它
+                // 认领由哪个线程确认都可以，只要 sleepers + claimed 等于等待中的线程数
+                if (shard.claimed > 0) {
+                    shard.claimed--;
+                    shard.sleepers.fetch_add(1, std::memory_order_seq_cst);
+                }
+            }
+            if (shard.claimed > 0) {
+                shard.claimed--;
+            } else {
+                shard.sleepers.fetch_sub(1, std::memory_order_relaxed);
+            }
+            idle_threads_--;
+            if (is_stop_.load() && queued_.load() == 0) return;
+        }
+    }
+
+    int pool_size_;
+    std::atomic<int> idle_threads_;
+    std::atomic<int64_t> queued_;   // 所有分片中的任务总数
+    std::atomic<bool> is_stop_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<std::thread> threads_;
+};
+
+#endif
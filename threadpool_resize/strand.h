@@ -0,0 +1,303 @@
+#ifndef __STRAND__
+#define __STRAND__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "inline_task.h"
+#include "thread_pool.h"
+
+namespace detail {
+
+// 串行队列的节点，任务直接存放在节点内，节点从 BlockPool 分配
+struct StrandNode {
+    std::atomic<StrandNode*> next{nullptr};
+    InlineTask task;
+};
+
+// 一个 strand 的共享状态。有待执行的任务时，恰好有一个 Run 在线程池中排队或执行
+// pending_ 由 0 变为 1 的提交者负责调度 Run，Run 每轮最多执行 batch_limit_ 个任务，
+// 之后还有任务就把自己重新放回线程池队尾，让其他 strand 和普通任务也能得到执行
+template<typename Pool>
+class StrandState : public std::enable_shared_from_this<StrandState<Pool>> {
+public:
+    StrandState(Pool& pool, int batch_limit)
+        : pool_(pool),
+          batch_limit_(std::max(batch_limit, 1)),
+          head_(&stub_),
+          tail_(&stub_),
+          pending_(0),
+          handles_(1) {}
+
+    ~StrandState() {
+        // 线程池已经关闭时可能还有没执行的任务
+        while (StrandNode* node = Pop()) {
+            FreeNode(node);
+        }
+    }
+
+    StrandState(const StrandState&) = delete;
+    StrandState& operator=(const StrandState&) = delete;
+
+    void Post(InlineTask&& task) {
+        PoolAllocator<StrandNode> alloc;
+        StrandNode* node = alloc.allocate(1);
+        new (node) StrandNode();
+        node->task = std::move(task);
+        Push(node);
+        // 先入队再计数，Run 看到的计数不会超过已经入队的任务数
+        if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+            Schedule();
+        }
+    }
+
+    size_t Pending() const {
+        return pending_.load(std::memory_order_relaxed);
+    }
+
+    void AddHandle() {
+        handles_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ReleaseHandle() {
+        handles_.fetch_sub(1, std::memory_order_release);
+    }
+
+    // 只剩一个 Strand 引用（KeyedExecutor 表中的那个）并且没有待执行的任务
+    // 排队或者正在收尾的 Run 也持有共享状态，但计数为 0 时它不会再执行任何任务，不影响判断
+    bool Idle() const {
+        return handles_.load(std::memory_order_acquire) == 1 &&
+               pending_.load(std::memory_order_acquire) == 0;
+    }
+
+    bool RunningInThisThread() const {
+        return Current() == this;
+    }
+
+private:
+    void Schedule() {
+        pool_.Post([self = this->shared_from_this()]() { self->Run(); });
+    }
+
+    void Run() {
+        const void* outer = Current();
+        Current() = this;
+        // 只有 Run 会减少计数，这里读到的数量一定都已经入队，最多只会更多
+        size_t budget = std::min<size_t>(pending_.load(std::memory_order_acquire), batch_limit_);
+        for (size_t i = 0; i < budget; ++i) {
+            StrandNode* node = Pop();
+            // 提交者已经交换了 head_ 但还没有链接 next，很快就会完成
+            while (node == nullptr) {
+                std::this_thread::yield();
+                node = Pop();
+            }
+            node->task();
+            FreeNode(node);
+        }
+        Current() = outer;
+        if (pending_.fetch_sub(budget, std::memory_order_acq_rel) > budget) {
+            Schedule();
+        }
+    }
+
+    // 多生产者入队：一次原子交换，不加锁
+    void Push(StrandNode* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        StrandNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 单消费者出队，只在 Run 中调用（同一时刻只有一个 Run）
+    // 队列为空或者某个提交者入队到一半时返回 nullptr
+    StrandNode* Pop() {
+        StrandNode* tail = tail_;
+        StrandNode* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (next == nullptr) return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+        // tail 是最后一个节点，放回哨兵节点后才能把它取走
+        Push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    static void FreeNode(StrandNode* node) {
+        node->~StrandNode();
+        PoolAllocator<StrandNode>().deallocate(node, 1);
+    }
+
+    // 当前线程正在执行的 strand，嵌套的 Run（例如 Get 中帮忙执行）结束后恢复
+    static const void*& Current() {
+        static thread_local const void* current = nullptr;
+        return current;
+    }
+
+    Pool& pool_;
+    size_t batch_limit_;
+    StrandNode stub_;
+    alignas(64) std::atomic<StrandNode*> head_;  // 提交者写
+    alignas(64) StrandNode* tail_;               // 只有 Run 读写
+    std::atomic<size_t> pending_;
+    std::atomic<int> handles_;  // Strand 副本的数量，不包括调度中的 Run
+};
+
+}  // namespace detail
+
+// 串行执行器：提交到同一个 strand 的任务按提交顺序逐个执行，不会并发，
+// 不同 strand 的任务在线程池中并行。strand 不占用线程，空闲时只是一块内存
+// 可以复制，副本共享同一个队列；任务可能晚于所有副本析构才执行完
+template<typename Pool = ThreadPool>
+class Strand {
+public:
+    // batch_limit 是每轮最多连续执行的任务数，之后让出工作线程
+    explicit Strand(Pool& pool, int batch_limit = 64)
+        : state_(std::make_shared<detail::StrandState<Pool>>(pool, batch_limit)) {}
+
+    Strand(const Strand& other) : state_(other.state_) {
+        state_->AddHandle();
+    }
+
+    Strand(Strand&& other) noexcept = default;
+
+    Strand& operator=(Strand other) noexcept {
+        std::swap(state_, other.state_);
+        return *this;
+    }
+
+    ~Strand() {
+        if (state_) state_->ReleaseHandle();
+    }
+
+    template<typename F, typename... Args>
+    auto Submit(F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
+        using ret_type = decltype(f(args...));
+        std::promise<ret_type> promise = MakePooledPromise<ret_type>();
+        std::future<ret_type> func_future = promise.get_future();
+        state_->Post(MakePromiseTask(std::move(promise), std::forward<F>(f),
+                                     std::forward<Args>(args)...));
+        return func_future;
+    }
+
+    // 与 ThreadPool::Post 一样，任务不应抛出异常
+    template<typename F>
+    void Post(F&& f) {
+        state_->Post(InlineTask(std::forward<F>(f)));
+    }
+
+    // 已提交但还没有执行完的任务数
+    size_t Pending() const { return state_->Pending(); }
+
+    // 当前线程是否正在执行这个 strand 的任务
+    bool RunningInThisThread() const { return state_->RunningInThisThread(); }
+
+private:
+    template<typename K, typename H, typename P>
+    friend class KeyedExecutor;
+
+    // 调用者没有持有副本，也没有待执行的任务，可以安全丢弃
+    bool Idle() const { return state_->Idle(); }
+
+    std::shared_ptr<detail::StrandState<Pool>> state_;
+};
+
+// 按 key 串行的执行器：同一个 key 的任务按提交顺序执行，不同 key 之间并行
+// 每个 key 第一次提交时创建 strand，key 的数量只影响内存；
+// 按 key 的哈希分片加锁，不同分片的提交互不争用
+template<typename Key, typename Hash = std::hash<Key>, typename Pool = ThreadPool>
+class KeyedExecutor {
+public:
+    explicit KeyedExecutor(Pool& pool, int batch_limit = 64, int shards = 64)
+        : pool_(pool), batch_limit_(batch_limit) {
+        for (int i = 0; i < std::max(shards, 1); ++i) {
+            shards_.emplace_back(new Shard());
+        }
+    }
+
+    template<typename F, typename... Args>
+    auto Submit(const Key& key, F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
+        return StrandFor(key).Submit(std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template<typename F>
+    void Post(const Key& key, F&& f) {
+        StrandFor(key).Post(std::forward<F>(f));
+    }
+
+    // 返回 key 对应的 strand，不存在时创建。频繁向同一个 key 提交时可以保存下来，省去查表
+    Strand<Pool> StrandFor(const Key& key) {
+        Shard& shard = ShardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.strands.find(key);
+        if (it == shard.strands.end()) {
+            it = shard.strands.emplace(key, Strand<Pool>(pool_, batch_limit_)).first;
+        }
+        return it->second;
+    }
+
+    // 删除所有空闲的 strand：没有待执行的任务，调用者也没有持有副本
+    // 之后再向这些 key 提交会创建新的 strand，顺序不受影响。返回删除的数量
+    size_t Trim() {
+        size_t removed = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mtx);
+            for (auto it = shard->strands.begin(); it != shard->strands.end();) {
+                if (it->second.Idle()) {
+                    it = shard->strands.erase(it);
+                    ++removed;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return removed;
+    }
+
+    size_t Size() const {
+        size_t total = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard->mtx);
+            total += shard->strands.size();
+        }
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard {
+        mutable std::mutex mtx;
+        std::unordered_map<Key, Strand<Pool>, Hash> strands;
+    };
+
+    Shard& ShardOf(const Key& key) {
+        // 混合一次哈希值，整数 key 的 std::hash 是恒等映射，低位分布可能不均匀
+        size_t h = Hash()(key) * 0x9E3779B97F4A7C15ull;
+        return *shards_[(h >> 32) % shards_.size()];
+    }
+
+    Pool& pool_;
+    int batch_limit_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+#endif
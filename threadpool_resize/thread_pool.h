@@ -3,20 +3,34 @@
 
 #include <thread>
 #include <vector>
-#include <queue>
-#include <functional>
 #include <future>
 #include <mutex>
 #include <atomic>
 #include <condition_variable>
 #include <chrono>
+#include <algorithm>
+
+#include "inline_task.h"
+#include "pool_metrics.h"
+#include "timer_wheel.h"
+#include "coro_task.h"
+#include "cancellation.h"
+
+template<typename T>
+class Future;
 
 class ThreadPool {
 public:
     ThreadPool(int size = std::thread::hardware_concurrency()) 
         : pool_size_(size), 
           idle_threads_(0),
+          live_threads_(0),
+          queue_size_(0),
           is_stop_(false) {
+        // 工作线程会在锁内读取 threads_.size()，创建线程时同样需要持锁
+        std::lock_guard<std::mutex> lock(mtx_);
+        // 创建时就计入线程数，刚构造完的线程池不会因为线程还没启动而报告 0 个线程
+        live_threads_.store(pool_size_.load(), std::memory_order_relaxed);
         for(int i = 0; i < pool_size_; ++i) {
             threads_.emplace_back([this]() {
                 worker();
@@ -29,6 +43,13 @@ public:
     }
 
     void ShutDown() {
+        // 先停止定时线程，之后不会再有定时任务进入队列
+        std::shared_ptr<TimerWheel> timers;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            timers = timers_;
+        }
+        if (timers) timers->Stop();
         {
             std::unique_lock<std::mutex> lock(mtx_);
             is_stop_ = true;
@@ -43,26 +64,172 @@ public:
     template<typename F, typename... Args>
     auto Submit(F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
         using ret_type = decltype(f(args...));
-        auto task_ptr = std::make_shared<std::packaged_task<ret_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
-        std::future<ret_type> func_future = task_ptr->get_future();
+        // promise 的共享状态从内存池分配，闭包直接存放在任务对象内部
+        std::promise<ret_type> promise = MakePooledPromise<ret_type>();
+        std::future<ret_type> func_future = promise.get_future();
+        Task task = MakePromiseTask(std::move(promise), std::forward<F>(f),
+                                    std::forward<Args>(args)...);
         {
             std::lock_guard<std::mutex> lock(mtx_);
-            tasks_.emplace([task_ptr]() {
-                (*task_ptr)();
-            });
+            PushLocked(std::move(task), NowNanos());
+        }
+        not_empty_.notify_one();
+        return func_future;
+    }
+
+    // 可取消的提交：任务出队时 token 已经取消则直接丢弃，future 得到 TaskCancelled
+    // 提交时已经取消的任务不进入队列；执行中的任务可以自行检查 token.IsCancelled()
+    template<typename F, typename... Args>
+    auto Submit(const CancellationToken& token, F&& f, Args&&... args)
+        -> std::future<decltype(f(args...))> {
+        using ret_type = decltype(f(args...));
+        std::promise<ret_type> promise = MakePooledPromise<ret_type>();
+        std::future<ret_type> func_future = promise.get_future();
+        if (token.IsCancelled()) {
+            promise.set_exception(std::make_exception_ptr(TaskCancelled()));
+            return func_future;
+        }
+        Task task = MakeCancellableTask(token, std::move(promise), std::forward<F>(f),
+                                        std::forward<Args>(args)...);
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            PushLocked(std::move(task), NowNanos());
+        }
+        not_empty_.notify_one();
+        return func_future;
+    }
+
+    // 提交任务并返回可以挂接后续任务的 Future，定义在 async_future.h 中
+    template<typename F, typename... Args>
+    auto SubmitAsync(F&& f, Args&&... args) -> Future<decltype(f(args...))>;
+
+    template<typename F, typename... Args>
+    auto SubmitAsync(const CancellationToken& token, F&& f, Args&&... args)
+        -> Future<decltype(f(args...))>;
+
+    // 等待 future 的结果。在本线程池的工作线程中调用时，结果就绪之前先执行队列中的其他任务，
+    // 而不是阻塞工作线程，线程数固定时递归地提交并等待子任务也不会死锁
+    // 其他线程调用时等同于 future.get()
+    // 帮忙执行的是全局 FIFO 队列队首的任务，不会优先执行自己等待的子任务：
+    // 队列较长时子任务要排到队首才会被执行，期间本线程会先执行其他无关任务，
+    // 递归很深时调用栈也随之变深。需要优先执行子任务时使用 simple_threadpool 的窃取模式
+    template<typename FutureType>
+    auto Get(FutureType& future) -> decltype(future.get()) {
+        WorkerContext& ctx = CurrentWorker();
+        if (ctx.pool == this) {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                // 队列为空时等待的子任务正在其他线程上运行，阻塞到它完成即可，不再轮询
+                if (!RunPendingTask(ctx.stats)) {
+                    future.wait();
+                    break;
+                }
+            }
+        }
+        return future.get();
+    }
+
+    // 同上，等待 SubmitAsync 返回的 Future，定义在 async_future.h 中
+    template<typename T>
+    T Get(Future<T>& future);
+
+    // 提交不关心返回值的任务，不创建 promise/future
+    template<typename F>
+    void Post(F&& f) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            PushLocked(Task(std::forward<F>(f)), NowNanos());
         }
         not_empty_.notify_one();
+    }
+
+    // 在本线程池的工作线程中调用时执行一个排队中的任务，其他线程调用或队列为空时返回 false
+    // 供 TaskGroup 这类等待者在等待期间帮忙执行
+    bool TryRunPending() {
+        WorkerContext& ctx = CurrentWorker();
+        return ctx.pool == this && RunPendingTask(ctx.stats);
+    }
+
+#if __cplusplus >= 202002L
+    // 在协程中 co_await pool.Schedule()，之后的代码在工作线程上执行
+    coro::ScheduleAwaitable<ThreadPool> Schedule() {
+        return coro::ScheduleAwaitable<ThreadPool>(*this);
+    }
+#endif
+
+    // 在 when 时刻之后执行任务，等待期间不占用工作线程
+    // 线程池关闭时尚未到期的任务被丢弃，对应的 future 得到 broken_promise
+    template<typename F, typename... Args>
+    auto SubmitAt(std::chrono::steady_clock::time_point when, F&& f, Args&&... args)
+        -> std::future<decltype(f(args...))> {
+        using ret_type = decltype(f(args...));
+        std::promise<ret_type> promise = MakePooledPromise<ret_type>();
+        std::future<ret_type> func_future = promise.get_future();
+        Task task = MakePromiseTask(std::move(promise), std::forward<F>(f),
+                                    std::forward<Args>(args)...);
+        Timers()->Schedule(when, TimerWheel::Clock::duration::zero(), std::move(task));
         return func_future;
     }
 
+    // 延迟 delay 之后执行任务
+    template<typename Rep, typename Period, typename F, typename... Args>
+    auto SubmitAfter(std::chrono::duration<Rep, Period> delay, F&& f, Args&&... args)
+        -> std::future<decltype(f(args...))> {
+        return SubmitAt(std::chrono::steady_clock::now() +
+                            std::chrono::duration_cast<TimerWheel::Clock::duration>(delay),
+                        std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // 每隔 period 执行一次 f，第一次在 period 之后，返回的句柄可以取消
+    // 上一次执行还没有结束时跳过本次；f 抛出的异常被丢弃，次数由 TimerHandle::Failures 查询
+    template<typename Rep, typename Period, typename F>
+    TimerHandle SubmitEvery(std::chrono::duration<Rep, Period> period, F&& f) {
+        auto interval = std::chrono::duration_cast<TimerWheel::Clock::duration>(period);
+        return TimerHandle(Timers()->Schedule(std::chrono::steady_clock::now() + interval,
+                                              interval, Task(std::forward<F>(f))));
+    }
+
+    // 批量提交：对 [first, last) 中的每个元素提交一个 fn(*it) 任务
+    // 整批任务只加一次锁，并且只唤醒 min(任务数, 空闲线程数) 个线程
+    template<typename Iter, typename F>
+    auto SubmitBulk(Iter first, Iter last, F fn)
+        -> std::vector<std::future<decltype(fn(*first))>> {
+        using ret_type = decltype(fn(*first));
+        std::vector<std::future<ret_type>> futures;
+        std::vector<Task> batch;
+        for (; first != last; ++first) {
+            std::promise<ret_type> promise = MakePooledPromise<ret_type>();
+            futures.push_back(promise.get_future());
+            batch.push_back(MakePromiseTask(std::move(promise), fn, *first));
+        }
+        EnqueueBatch(batch);
+        return futures;
+    }
+
+    // 批量提交一组同类型的可调用对象
+    template<typename F>
+    auto SubmitBatch(std::vector<F> fns)
+        -> std::vector<std::future<decltype(std::declval<F&>()())>> {
+        using ret_type = decltype(std::declval<F&>()());
+        std::vector<std::future<ret_type>> futures;
+        std::vector<Task> batch;
+        futures.reserve(fns.size());
+        batch.reserve(fns.size());
+        for (auto& fn : fns) {
+            std::promise<ret_type> promise = MakePooledPromise<ret_type>();
+            futures.push_back(promise.get_future());
+            batch.push_back(MakePromiseTask(std::move(promise), std::move(fn)));
+        }
+        EnqueueBatch(batch);
+        return futures;
+    }
+
     // 扩容方法
     void Expand(int new_size) {
         if (new_size <= pool_size_.load()) return;
         
         std::lock_guard<std::mutex> lock(mtx_);
         int add_num = new_size - pool_size_.load();
+        live_threads_.fetch_add(add_num, std::memory_order_relaxed);
         for (int i = 0; i < add_num; ++i) {
             threads_.emplace_back([this]() {
                 worker();
@@ -83,37 +250,130 @@ public:
         not_empty_.notify_all();
     }
 
-    // 获取当前线程池状态
+    // 获取当前线程池状态，只读取原子计数，不加锁
     struct PoolStatus {
         int total_threads;
         int idle_threads;
         int queue_size;
     };
     
-    PoolStatus GetStatus() {
-        std::lock_guard<std::mutex> lock(mtx_);
+    PoolStatus GetStatus() const {
         return {
-            static_cast<int>(threads_.size()),
-            idle_threads_.load(),
-            static_cast<int>(tasks_.size())
+            live_threads_.load(std::memory_order_relaxed),
+            idle_threads_.load(std::memory_order_relaxed),
+            queue_size_.load(std::memory_order_relaxed)
         };
     }
 
+    // 汇总各工作线程的计数器和延迟直方图，不加锁，不阻塞工作线程
+    PoolMetrics GetMetrics() const {
+        PoolMetrics metrics;
+        metrics_.Collect(metrics);
+        metrics.queue_size = queue_size_.load(std::memory_order_relaxed);
+        return metrics;
+    }
+
 private:
     std::atomic<int> pool_size_;      // 目标线程数
     std::atomic<int> idle_threads_;  // 空闲线程数
+    std::atomic<int> live_threads_;  // 已创建且还没有退出的工作线程数
+    std::atomic<int> queue_size_;    // 队列中的任务数
     std::atomic<bool> is_stop_;      // 停止标志
     
     std::vector<std::thread> threads_;
-    using Task = std::function<void()>;
-    std::queue<Task> tasks_;
+    using Task = InlineTask;
+    // 队列中的任务附带入队时间，用于统计排队时间
+    struct QueuedTask {
+        Task task;
+        uint64_t enqueue_ns = 0;
+    };
+    RingQueue<QueuedTask> tasks_;
 
     std::mutex mtx_;
     std::condition_variable not_empty_;
 
+    MetricsRegistry metrics_;
+
+    // 定时任务使用的时间轮，第一次提交定时任务时才创建
+    std::shared_ptr<TimerWheel> timers_;
+
+    std::shared_ptr<TimerWheel> Timers() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!timers_) {
+            timers_ = std::make_shared<TimerWheel>([this](InlineTask&& task) {
+                Post(std::move(task));
+            });
+        }
+        return timers_;
+    }
+
+    void PushLocked(Task&& task, uint64_t now) {
+        tasks_.push(QueuedTask{std::move(task), now});
+        queue_size_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void EnqueueBatch(std::vector<Task>& batch) {
+        if (batch.empty()) return;
+        size_t wake = 0;
+        size_t idle = 0;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            uint64_t now = NowNanos();
+            for (auto& task : batch) {
+                PushLocked(std::move(task), now);
+            }
+            idle = static_cast<size_t>(idle_threads_.load());
+            wake = std::min(batch.size(), idle);
+        }
+        if (wake == 0) return;
+        if (wake >= idle) {
+            not_empty_.notify_all();
+        } else {
+            for (size_t i = 0; i < wake; ++i) {
+                not_empty_.notify_one();
+            }
+        }
+    }
+
+    struct WorkerContext {
+        ThreadPool* pool = nullptr;
+        WorkerMetrics* stats = nullptr;
+    };
+    // 当前线程所属的线程池，用于识别任务内部的等待
+    static WorkerContext& CurrentWorker() {
+        static thread_local WorkerContext ctx;
+        return ctx;
+    }
+
+    void RunTask(QueuedTask& item, WorkerMetrics* stats) {
+        uint64_t start = NowNanos();
+        stats->queue_wait.Record(start - item.enqueue_ns);
+        item.task();
+        uint64_t end = NowNanos();
+        stats->run_time.Record(end - start);
+        WorkerMetrics::Add(stats->busy_ns, end - start);
+        WorkerMetrics::Add(stats->tasks_executed, 1);
+    }
+
+    // 工作线程等待时执行一个排队中的任务，队列为空时返回 false
+    bool RunPendingTask(WorkerMetrics* stats) {
+        QueuedTask item;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (tasks_.empty()) return false;
+            item = std::move(tasks_.front());
+            tasks_.pop();
+            queue_size_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        RunTask(item, stats);
+        return true;
+    }
+
     void worker() {
+        WorkerMetrics* stats = metrics_.Register();
+        CurrentWorker() = {this, stats};
         while(true) {
-            Task task;
+            QueuedTask item;
             {
                 std::unique_lock<std::mutex> lock(mtx_);
                 
@@ -121,10 +381,16 @@ private:
                 idle_threads_++;
                 
                 // 等待条件：有任务或需要停止或需要缩容
-                not_empty_.wait(lock, [this]() {
+                auto ready = [this]() {
                     return is_stop_ || !tasks_.empty() || 
                            threads_.size() > pool_size_.load();
-                });
+                };
+                if (!ready()) {
+                    uint64_t idle_start = NowNanos();
+                    not_empty_.wait(lock, ready);
+                    WorkerMetrics::Add(stats->idle_ns, NowNanos() - idle_start);
+                    WorkerMetrics::Add(stats->wakeups, 1);
+                }
                 
                 // 更新空闲线程计数
                 idle_threads_--;
@@ -132,6 +398,8 @@ private:
                 // 退出条件：停止且无任务，或需要缩容且当前线程是多余的
                 if ((is_stop_ && tasks_.empty()) || 
                     (threads_.size() > pool_size_.load())) {
+                    stats->alive.store(false, std::memory_order_relaxed);
+                    live_threads_.fetch_sub(1, std::memory_order_relaxed);
                     // 如果是缩容导致的退出，从线程列表中移除当前线程
                     if (threads_.size() > pool_size_.load()) {
                         auto thread_id = std::this_thread::get_id();
@@ -147,12 +415,13 @@ private:
                 }
                 
                 // 获取任务
-                task = std::move(tasks_.front());
+                item = std::move(tasks_.front());
                 tasks_.pop();
+                queue_size_.fetch_sub(1, std::memory_order_relaxed);
             }
             
             // 执行任务
-            task();
+            RunTask(item, stats);
         }
     }
 };
@@ -0,0 +1,321 @@
+#ifndef __TIMER_WHEEL__
+#define __TIMER_WHEEL__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "inline_task.h"
+
+class TimerWheel;
+
+// 挂在时间轮槽位上的双向循环链表节点，每个槽位有一个哨兵节点
+struct TimerLink {
+    TimerLink* prev = this;
+    TimerLink* next = this;
+
+    bool Linked() const { return next != this; }
+
+    void InsertBefore(TimerLink* pos) {
+        prev = pos->prev;
+        next = pos;
+        pos->prev->next = this;
+        pos->prev = this;
+    }
+
+    void Unlink() {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = this;
+    }
+};
+
+// 一个定时器。挂在时间轮上时通过 self 持有自身，摘下后由调用方决定生命周期
+struct TimerNode : TimerLink {
+    uint64_t expire = 0;   // 到期的 tick
+    uint64_t period = 0;   // 周期 tick 数，0 表示一次性定时器
+    InlineTask task;
+    std::shared_ptr<TimerNode> self;
+    std::weak_ptr<TimerWheel> wheel;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> running{false};  // 周期任务上一次执行尚未结束
+    std::atomic<uint64_t> failures{0};  // 周期任务抛出异常的次数
+};
+
+// SubmitEvery 返回的句柄，可以取消周期任务；线程池析构后调用 Cancel 也是安全的
+class TimerHandle {
+public:
+    TimerHandle() = default;
+    explicit TimerHandle(std::shared_ptr<TimerNode> node) : node_(std::move(node)) {}
+
+    // 取消定时器，已经到期的那一次执行不受影响
+    // 定时器还挂在时间轮上时返回 true；一次性定时器返回 false 说明任务已经到期，仍会执行
+    bool Cancel();
+
+    bool Cancelled() const {
+        return !node_ || node_->cancelled.load(std::memory_order_acquire);
+    }
+
+    // 周期任务抛出异常的次数。异常被捕获后丢弃，定时器照常继续
+    uint64_t Failures() const {
+        return node_ ? node_->failures.load(std::memory_order_relaxed) : 0;
+    }
+
+private:
+    std::shared_ptr<TimerNode> node_;
+};
+
+// 分层时间轮：4 层，每层 256 个槽，tick 为 1ms，可以表示约 49 天内的定时
+// 插入和取消只是链表操作，都是 O(1)；
+// 第 0 层每转一圈，把上一层对应槽位中的定时器重新分配到下层
+// 由一个定时线程推进时间轮，到期的任务交给 dispatch 投递到线程池执行
+class TimerWheel : public std::enable_shared_from_this<TimerWheel> {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Dispatch = std::function<void(InlineTask&&)>;
+
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 8;
+    static constexpr uint64_t kSlots = uint64_t(1) << kSlotBits;
+    static constexpr uint64_t kSlotMask = kSlots - 1;
+    static constexpr uint64_t kMaxDelta = (uint64_t(1) << (kLevels * kSlotBits)) - 1;
+
+    explicit TimerWheel(Dispatch dispatch)
+        : dispatch_(std::move(dispatch)), start_(Clock::now()) {}
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    ~TimerWheel() { Stop(); }
+
+    // 添加定时器，when 之后执行 task；period 不为 0 时之后每隔 period 执行一次
+    // 定时线程在第一次添加定时器时才创建
+    std::shared_ptr<TimerNode> Schedule(Clock::time_point when,
+                                        Clock::duration period, InlineTask task) {
+        auto node = std::make_shared<TimerNode>();
+        node->task = std::move(task);
+        node->wheel = weak_from_this();
+        if (period > Clock::duration::zero()) {
+            node->period = std::max<uint64_t>(1, CeilTicks(period));
+        }
+        bool notify = false;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (stop_) return node;
+            if (!thread_.joinable()) {
+                thread_ = std::thread([this]() { Run(); });
+            }
+            node->expire = std::max(TickOf(when), current_ + 1);
+            node->self = node;
+            Insert(node.get());
+            ++pending_;
+            // 只有新定时器比定时线程计划醒来的时间更早时才需要唤醒它
+            notify = node->expire < next_wake_;
+        }
+        if (notify) cond_.notify_one();
+        return node;
+    }
+
+    // 把定时器从时间轮上摘下，O(1)
+    bool Cancel(TimerNode* node) {
+        std::shared_ptr<TimerNode> keep;
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!node->Linked()) return false;
+        node->Unlink();
+        --pending_;
+        keep = std::move(node->self);
+        return true;
+    }
+
+    // 停止定时线程，丢弃所有未到期的定时器
+    // 一次性定时器的 promise 随之析构，对应的 future 得到 broken_promise
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (stop_) return;
+            stop_ = true;
+        }
+        cond_.notify_one();
+        if (thread_.joinable()) thread_.join();
+
+        std::vector<std::shared_ptr<TimerNode>> dropped;
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto& level : slots_) {
+            for (auto& head : level) {
+                while (head.Linked()) {
+                    auto* node = static_cast<TimerNode*>(head.next);
+                    node->Unlink();
+                    dropped.push_back(std::move(node->self));
+                }
+            }
+        }
+        pending_ = 0;
+    }
+
+    // 尚未到期的定时器数量
+    size_t Pending() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return pending_;
+    }
+
+private:
+    uint64_t CeilTicks(Clock::duration d) const {
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(d).count();
+        return ms > 0 ? static_cast<uint64_t>(ms) : 0;
+    }
+
+    // 时间点对应的 tick，向上取整，保证定时器不会提前执行
+    uint64_t TickOf(Clock::time_point tp) const {
+        return CeilTicks(tp - start_);
+    }
+
+    void Insert(TimerNode* node) {
+        uint64_t delta = node->expire - current_;
+        uint64_t expire = node->expire;
+        if (delta > kMaxDelta) {
+            // 超出时间轮范围，先放在最高层，转到时再重新分配
+            expire = current_ + kMaxDelta;
+            delta = kMaxDelta;
+        }
+        int level = 0;
+        while (level < kLevels - 1 && delta >= (uint64_t(1) << ((level + 1) * kSlotBits))) {
+            ++level;
+        }
+        uint64_t slot = (expire >> (level * kSlotBits)) & kSlotMask;
+        node->InsertBefore(&slots_[level][slot]);
+    }
+
+    // 把第 level 层当前槽位中的定时器重新分配到下层
+    void Cascade(int level) {
+        uint64_t slot = (current_ >> (level * kSlotBits)) & kSlotMask;
+        TimerLink moved;
+        TimerLink& head = slots_[level][slot];
+        while (head.Linked()) {
+            TimerLink* link = head.next;
+            link->Unlink();
+            link->InsertBefore(&moved);
+        }
+        while (moved.Linked()) {
+            auto* node = static_cast<TimerNode*>(moved.next);
+            node->Unlink();
+            Insert(node);
+        }
+    }
+
+    // 推进到 now_tick，收集到期的定时器
+    void Advance(uint64_t now_tick, std::vector<std::shared_ptr<TimerNode>>& due) {
+        if (pending_ == 0) {
+            current_ = std::max(current_, now_tick);
+            return;
+        }
+        while (current_ < now_tick) {
+            ++current_;
+            for (int level = 1; level < kLevels; ++level) {
+                if ((current_ & ((uint64_t(1) << (level * kSlotBits)) - 1)) != 0) break;
+                Cascade(level);
+            }
+            TimerLink& head = slots_[0][current_ & kSlotMask];
+            while (head.Linked()) {
+                auto* node = static_cast<TimerNode*>(head.next);
+                node->Unlink();
+                --pending_;
+                due.push_back(std::move(node->self));
+            }
+        }
+    }
+
+    // 下一次需要醒来的 tick：第 0 层中最近的非空槽位，或者下一次重新分配的时刻
+    uint64_t NextWakeTick() const {
+        uint64_t boundary = (current_ | kSlotMask) + 1;
+        for (uint64_t tick = current_ + 1; tick < boundary; ++tick) {
+            if (slots_[0][tick & kSlotMask].Linked()) return tick;
+        }
+        return boundary;
+    }
+
+    void Run() {
+        std::vector<std::shared_ptr<TimerNode>> due;
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (!stop_) {
+            Advance(TickOf(Clock::now()), due);
+            // 周期定时器在锁内重新挂回时间轮
+            for (auto& node : due) {
+                if (node->period == 0 || node->cancelled.load(std::memory_order_acquire)) {
+                    continue;
+                }
+                uint64_t late = current_ - node->expire;
+                node->expire += (late / node->period + 1) * node->period;
+                node->self = node;
+                Insert(node.get());
+                ++pending_;
+            }
+            if (!due.empty()) {
+                lock.unlock();
+                Fire(due);
+                due.clear();
+                lock.lock();
+                continue;
+            }
+            if (pending_ == 0) {
+                next_wake_ = UINT64_MAX;
+                cond_.wait(lock);
+            } else {
+                next_wake_ = NextWakeTick();
+                cond_.wait_until(lock, start_ + std::chrono::milliseconds(next_wake_));
+            }
+            next_wake_ = 0;
+        }
+    }
+
+    // 在锁外把到期的任务投递到线程池
+    void Fire(std::vector<std::shared_ptr<TimerNode>>& due) {
+        for (auto& node : due) {
+            if (node->period == 0) {
+                dispatch_(std::move(node->task));
+                continue;
+            }
+            if (node->cancelled.load(std::memory_order_acquire)) continue;
+            // 上一次执行还没有结束时跳过本次，避免同一个周期任务并发执行
+            if (node->running.exchange(true, std::memory_order_acq_rel)) continue;
+            // 异常不能逃出投递的任务，否则工作线程会调用 std::terminate；
+            // running 无论成功与否都要复位，否则之后的每一次都会被跳过
+            dispatch_(InlineTask([node]() {
+                try {
+                    node->task();
+                } catch (...) {
+                    node->failures.fetch_add(1, std::memory_order_relaxed);
+                }
+                node->running.store(false, std::memory_order_release);
+            }));
+        }
+    }
+
+    Dispatch dispatch_;
+    const Clock::time_point start_;
+
+    mutable std::mutex mtx_;
+    std::condition_variable cond_;
+    std::thread thread_;
+    bool stop_ = false;
+    uint64_t current_ = 0;     // 已经处理过的 tick
+    uint64_t next_wake_ = 0;   // 定时线程计划醒来的 tick，0 表示正在处理
+    size_t pending_ = 0;
+    TimerLink slots_[kLevels][kSlots];
+};
+
+inline bool TimerHandle::Cancel() {
+    if (!node_) return false;
+    node_->cancelled.store(true, std::memory_order_release);
+    if (auto wheel = node_->wheel.lock()) {
+        return wheel->Cancel(node_.get());
+    }
+    return false;
+}
+
+#endif